@@ -66,7 +66,7 @@ ClickEncoder::ClickEncoder(uint8_t A, uint8_t B, uint8_t BTN, uint8_t stepsPerNo
 // ----------------------------------------------------------------------------
 // call this every 1 millisecond via timer ISR
 //
-void ClickEncoder::service(void)
+void __not_in_flash_func(ClickEncoder::service)(void)
 {
   bool moved = false;
   unsigned long now = millis();
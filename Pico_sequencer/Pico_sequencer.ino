@@ -49,6 +49,7 @@
 //#include <Adafruit_S6D02A1.h> // Hardware-specific library for S6D02A1
 #include <Adafruit_TinyUSB.h>
 #include <MIDI.h>
+#include <hardware/structs/xip_ctrl.h>
 #include "Clickencoder.h"
 //#include "StepSeq.h"
 
@@ -61,30 +62,45 @@
 // currently, only output to a serial midi device is possible. Should be extended to input (transport commands, synchronisation)
 #define SERIAL_MIDI
 
+// the clock, note and MIDI output code is marked __not_in_flash_func so it runs from RAM - a flash cache miss stalls
+// for microseconds. uncomment this to leave it in flash like everything else and compare the tick times
+//#define HOTPATH_IN_FLASH
+#ifdef HOTPATH_IN_FLASH
+  #undef __not_in_flash_func
+  #define __not_in_flash_func(f) f
+#endif
+
 
 #define TRUE 1
 #define FALSE 0
 
-#define NTRACKS 4 // number of sequencer tracks - each track has notes, gates etc
+#define NTRACKS 4 // number of sequencer tracks 1-16 - each track has notes, gates etc
+#include "tracks.h"  // per track table generation - has to come right after NTRACKS
+#define SEQ_STATE  // storage class for the sequencer engine state - the host batch renderer makes it thread_local
 
-// I used mostly int16 types - its what the menu requires and the compiler seems to deal with basic conversions
+// the menu handles values as int16 but parameters can be stored as int8, uint8 or single bits to save RAM - see bindtype in menusystem.h
 
 //int16_t steps = 8; // initial number of steps
 
+// DEBUG, DEBUG_F and DEBUG_LN print straight away so they are for core 0 only
+// core 1 uses LOG which queues a binary record for core 0 to print later - see debuglog.h
 #ifdef SERIAL_DEBUG
-  #define DEBUG(msg) Serial.print("msg");
-  #define DEBUG_F(msg) Serial.printf(msg);
-  #define DEBUG_LN(msg) Serial.println("msg");
+  #include "debuglog.h"
+  #define DEBUG(msg) Serial.print(msg);
+  #define DEBUG_F(...) Serial.printf(__VA_ARGS__);
+  #define DEBUG_LN(msg) Serial.println(msg);
+  #define LOG(format,a,b,c) logwrite(format,a,b,c);
+  #define BOOTMARK(mark) bootmark(mark);
 #else
   #define DEBUG(msg) 
-  #define DEBUG_F(msg) 
+  #define DEBUG_F(...) 
   #define DEBUG_LN(msg)
+  #define LOG(format,a,b,c)
+  #define BOOTMARK(mark)
 #endif
 
-#ifdef SERIAL_MIDI
-  #define USB_MIDI_TIMEOUT 2*1000 // usb midi timout at startup
-  bool useMidiUSB=false; // has usb midi been detected at startup ?
-#endif
+volatile bool useMidiUSB=false; // USB port attached to the output router - follows USB mount/unmount while running
+volatile bool peripheralsready=false; // set by core 0 once MIDI is set up - core 1 waits for it
 
 bool startbutton;  // start/stop button state
 bool running=true; // sequencer running flag
@@ -92,32 +108,34 @@ bool shift =0;
 
 // graphical editing UI states - UI logic assumes an init state and an edit state for each
 // text parameter editing system has its own state machine for historical reasons
-// the text menu system requires parameters to be 16 bit integers which is why most of the data types are int16
+// the text menu system works in int16 but parameters can be bound as smaller types - see bindtype in menusystem.h
 
-enum UISTATES {NOTE_DRAW,NOTE_EDIT,GATE_DRAW,GATE_EDIT,VELOCITY_DRAW,VELOCITY_EDIT,OFFSET_DRAW,OFFSET_EDIT,PROBABILITY_DRAW,PROBABILITY_EDIT,RATCHET_DRAW,RATCHET_EDIT,MOD_DRAW,MOD_EDIT,DISPLAYOFF,DORMANT};
+enum UISTATES {NOTE_DRAW,NOTE_EDIT,GATE_DRAW,GATE_EDIT,VELOCITY_DRAW,VELOCITY_EDIT,OFFSET_DRAW,OFFSET_EDIT,PROBABILITY_DRAW,PROBABILITY_EDIT,RATCHET_DRAW,RATCHET_EDIT,MOD_DRAW,MOD_EDIT,TIMING_DRAW,TIMING_EDIT,OVERVIEW_DRAW,OVERVIEW_EDIT,DISPLAYOFF,DORMANT};
 // initial states on each page
-int16_t UIpages[] = {NOTE_DRAW,GATE_DRAW,VELOCITY_DRAW,OFFSET_DRAW,PROBABILITY_DRAW,RATCHET_DRAW,MOD_DRAW};
+const int16_t UIpages[] = {NOTE_DRAW,GATE_DRAW,VELOCITY_DRAW,OFFSET_DRAW,PROBABILITY_DRAW,RATCHET_DRAW,MOD_DRAW,TIMING_DRAW,OVERVIEW_DRAW};
 int16_t UIpage=0;
 #define NUMUIPAGES sizeof(UIpages)/sizeof(int16_t)
 bool menumode=0;  // when true we are in the text menu system
 int16_t UI_state=NOTE_DRAW; // initial UI state
 
 int16_t current_track=0; // track we are editing
-int16_t MIDIchannel[NTRACKS] = {1,2,3,4}; // midi channel to use for sequencer notes
-int16_t trackenabled[NTRACKS] = {1,0,0,0}; // 1 if track on is 1, 0 if off
-int16_t CCchannel[NTRACKS] = {1,2,3,4}; // midi channel to use for CCs
-int16_t mod_enabled[NTRACKS] = {0,0,0,0}; // 1 if mod sequencer for track is on, 0 if off
+uint8_t MIDIchannel[NTRACKS] = {FOR_EACH_TRACK(TRACK_NUMBER)}; // midi channel to use for sequencer notes - track 1 on channel 1 etc
+uint16_t trackenabled = 1; // one bit per track, 1 if track is on. only track 1 on at startup
+uint8_t CCchannel[NTRACKS] = {FOR_EACH_TRACK(TRACK_NUMBER)}; // midi channel to use for CCs
+uint16_t mod_enabled; // one bit per track, 1 if mod sequencer for track is on
+uint16_t mod_ramp; // one bit per track, 1 if mod CCs ramp smoothly between steps at clock tick resolution
 
 #define DISPLAY_BLANK_MS 120*1000  // display blanking time
 int32_t displaytimer; // display blanking timer
 
 #define TEMPO    120
-#define PPQN 24  // clocks per quarter note
-int16_t bpm = TEMPO;
+#define PPQN 96  // internal clocks per quarter note - lane rates, gates, ratchets and timing are worked out at this resolution
+#define MIDI_PPQN 24  // MIDI clocks per quarter note
+uint8_t bpm = TEMPO; // 20-240 fits in a byte
 int32_t lastMIDIclock; // timestamp of last MIDI clock
-int16_t MIDIclocks=PPQN*2; // midi clock counter
+int16_t MIDIclocks=MIDI_PPQN*2; // midi clock counter
 int16_t MIDIsync = 16;  // number of clocks required to sync BPM
-int16_t useMIDIclock = 0; // true if we are using MIDI clock
+uint8_t useMIDIclock = 0; // true if we are using MIDI clock
 
 enum CONTROLSTATES {IDLE,STARTUP,RUNNING,RUNJUSTSYNCED,SHUTDOWN}; // control state machine states
 int16_t controlstate=0; // state machine state
@@ -128,7 +146,7 @@ uint8_t shiftbut_count;
 // sequencer object
 //StepSeq seq = StepSeq(128);
 
-const char * notenames[]={"C","C#","D","D#","E","F","F#","G","G#","A","A#","B","C"};
+const char * const notenames[]={"C","C#","D","D#","E","F","F#","G","G#","A","A#","B","C"};
 
 #define NENC 16 // number of encoders
 
@@ -228,7 +246,7 @@ MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MidiSerial);
 // scans thru the multiplexed encoders and handles the menu encoder
 // debounces the buttons
 
-bool TimerHandler0(struct repeating_timer *t)
+bool __not_in_flash_func(TimerHandler0)(struct repeating_timer *t)
 {
   (void) t;
 
@@ -287,41 +305,126 @@ void displayupdate(){
 // midi related stuff - after initialization all MIDI stuff runs on core1 for timing accuracy
 // splitting it across both cores causes MidiUSB to hang eventually
 
-// note that the Adafruit stack expects MIDI channel to be 1-16, not 0-15
-void noteOn(byte channel, byte pitch, byte velocity) {
-  if (useMidiUSB) MidiUSB.sendNoteOn(pitch,velocity,channel+1);
+#include "midiout.h"  // port definitions, bandwidth accounting and output scheduler
+
+// true if a port should get output
+bool portenabled(uint8_t port) {
+  if (port==PORT_USB) return useMidiUSB;
 #ifdef SERIAL_MIDI
-  MidiSerial.sendNoteOn(pitch,velocity,channel+1);
+  return true;
+#else
+  return false;
 #endif
-  DEBUG_F("\"Noteon ch %d pitch %d vel %d \n\",channel,pitch,velocity")
 }
 
-void noteOff(byte channel, byte pitch, byte velocity) {
-  if (useMidiUSB) MidiUSB.sendNoteOff(pitch,velocity,channel+1);
+// write one message to a port's transport - only called from flushmidi()
+void __not_in_flash_func(portwrite)(uint8_t port, const midimsg *m) {
+  if (port==PORT_USB) {
+    if (m->status >= 0xF8) MidiUSB.sendRealTime((midi::MidiType)m->status);
+    else MidiUSB.send((midi::MidiType)(m->status & 0xF0),m->data1,m->data2,(m->status & 0x0F)+1);
+  }
 #ifdef SERIAL_MIDI
-  MidiSerial.sendNoteOff(pitch,velocity,channel+1);
+  else {
+    if (m->status >= 0xF8) MidiSerial.sendRealTime((midi::MidiType)m->status);
+    else MidiSerial.send((midi::MidiType)(m->status & 0xF0),m->data1,m->data2,(m->status & 0x0F)+1);
+  }
 #endif
-  DEBUG_F("\"Noteoff ch %d pitch %d vel %d \n\",channel,pitch,velocity")
 }
 
-// First parameter is the event type (0x0B = control change).
-// Second parameter is the event type, combined with the channel.
-// Third parameter is the control number number (0-119).
-// Fourth parameter is the control value (0-127).
+// send whatever the scheduler says should go out now, highest priority first
+// called at the end of each clock tick and from loop1() so held back CCs go out as the ports drain
+void __not_in_flash_func(flushmidi)(void) {
+  midimsg m;
+  uint32_t now=micros();
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    while (nextmsg(port,now,&m)) portwrite(port,&m);
+  }
+}
 
-void controlChange(byte channel, byte control, byte value) {
-  if (useMidiUSB) MidiUSB.sendControlChange(control,value,channel+1);
-#ifdef SERIAL_MIDI
-  MidiSerial.sendControlChange(control,value,channel+1);
-#endif
+// queue a message on every port in use
+void __not_in_flash_func(queueall)(uint8_t status, uint8_t data1, uint8_t data2) {
+  uint32_t now=micros();
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    if (portenabled(port)) queuemsg(port,status,data1,data2,now);
+  }
+}
+
+// note that the Adafruit stack expects MIDI channel to be 1-16, not 0-15
+// messages are queued for the output scheduler - they go out on the next flushmidi()
+void __not_in_flash_func(noteOn)(byte channel, byte pitch, byte velocity) {
+  queueall(midi::NoteOn | channel,pitch,velocity);
+  BOOTMARK(BOOT_FIRSTNOTE)
+  LOG(LOG_NOTEON,channel,pitch,velocity)
 }
 
+void __not_in_flash_func(noteOff)(byte channel, byte pitch, byte velocity) {
+  queueall(midi::NoteOff | channel,pitch,velocity);
+  LOG(LOG_NOTEOFF,channel,pitch,velocity)
+}
+
+// send a CC to one port only - used when ports have different bandwidth budgets
+// returns true if the message was queued
+bool __not_in_flash_func(controlChangePort)(uint8_t port, byte channel, byte control, byte value) {
+  if (!portenabled(port)) return false;
+  return queuemsg(port,midi::ControlChange | channel,control,value,micros());
+}
+
+// note off to one port only - used by all_notes_off() to turn off just what that port has sounding
+bool __not_in_flash_func(noteOffPort)(uint8_t port, byte channel, byte pitch, byte velocity) {
+  if (!portenabled(port)) return false;
+  return queuemsg(port,midi::NoteOff | channel,pitch,velocity,micros());
+}
+
+// flash cache misses on core 1 - the XIP counters are shared so anything core 0 runs from flash at the same time
+// is counted too. these are an upper bound
+uint32_t xipmiss_max; // most misses in a loop1() pass that rendered a tick
+
+uint32_t __not_in_flash_func(xipmisses)(void) {
+  return xip_ctrl_hw->ctr_acc-xip_ctrl_hw->ctr_hit;
+}
+
+#ifdef SERIAL_DEBUG
+// print output latency for each port and priority class
+void midireport(void) {
+  const char * const classnames[NUM_CLASSES]={"rt","note","cc"};
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    Serial.printf("%s:",port==PORT_USB ? "USB" : "DIN");
+    for (uint8_t cls=0; cls<NUM_CLASSES;++cls) {
+      midistat *st=&midistats[port][cls];
+      Serial.printf(" %s n %u avg %u max %u us coal %u drop %u",classnames[cls],(unsigned)st->count,
+        (unsigned)(st->count ? st->total_us/st->count : 0),(unsigned)st->max_us,(unsigned)st->coalesced,(unsigned)st->dropped);
+    }
+    midistat *st=&thrustats[port];
+    Serial.printf(" thru n %u avg %u max %u us\n",(unsigned)st->count,(unsigned)(st->count ? st->total_us/st->count : 0),(unsigned)st->max_us);
+  }
+}
+
+// flash cache hit rate since the last report and the worst tick - core 0
+void xipreport(void) {
+  static uint32_t lastacc,lasthit;
+  uint32_t acc=xip_ctrl_hw->ctr_acc;
+  uint32_t hit=xip_ctrl_hw->ctr_hit;
+  uint32_t accesses=acc-lastacc;
+  uint32_t hits=hit-lasthit;
+  Serial.printf("XIP cache accesses %u hits %u%% tick misses max %u\n",(unsigned)accesses,(unsigned)(accesses ? (uint64_t)hits*100/accesses : 100),(unsigned)xipmiss_max);
+  lastacc=acc;
+  lasthit=hit;
+}
+#endif
+
 
 // set up as include files because I'm too lazy to create proper header and .cpp files
 #include "scales.h"   //
+#include "events.h"  // timed note event queue
+#include "prng.h"   // per track random numbers
 #include "seq.h"   // has to come after midi note on/of
+#include "recorder.h"  // live note recording - has to come after seq.h
+#include "midithru.h"  // MIDI thru and merge
+#include "textblit.h"  // has to come after the display object creation
 #include "menusystem.h"  // has to come after display and encoder objects creation
+#include "sysex.h"  // SysEx dump and restore - has to come after everything it saves and the menus it checks restores against
 #include "graphics.h"   // has to come after display object creation
+#include "ramstats.h"   // has to come after everything it measures
 
 // these functions are here to avoid forward references. should really do proper include files!
 // there is some risk in processing MIDI start/stop etc on on core 0 since core 1 could also be using MIDI
@@ -342,11 +445,10 @@ void handleStart(void){
 // count MIDI clocks for a while to get a decent average and then compute BPM from it
 // if external MIDI clock is enabled use it as the master clock
 void handleClock(void){
-  long qn,clockperiod;
-  clockperiod= (long)(((60.0/(float)bpm)/PPQN)*1000); // for call to clocktick(). use calculated BPM which is more stable - MIDI clock has a lot of jitter
+  long qn;
   --MIDIclocks;
   if (MIDIclocks ==0 ) {
-    MIDIclocks=PPQN*2;
+    MIDIclocks=MIDI_PPQN*2;
     qn=millis()-lastMIDIclock;
     lastMIDIclock=millis();
     if (MIDIsync >0) --MIDIsync;
@@ -355,7 +457,7 @@ void handleClock(void){
     }
 //    Serial.printf("%d %d\n",qn,bpm);
   }
-  if (useMIDIclock) clocktick(clockperiod); 
+  if (useMIDIclock) midiclock(); // ticks in between are timed from the calculated BPM which is more stable - MIDI clock has a lot of jitter
 }
 
 // process MIDI stop message - stop playing
@@ -366,7 +468,14 @@ void handleStop(void){
   rp2040.resumeOtherCore();
 }
 
-// process MIDI continue message - continue playing
+// process MIDI song position pointer - the DAW has located somewhere in the song
+// position is in MIDI beats ie 16th notes. lanes jump straight there and the next clock plays that position
+void handleSongPosition(unsigned int beats){
+  all_notes_off();  // whatever was playing belongs to the old position
+  seek_sequencers((uint32_t)beats*(PPQN/4));
+}
+
+// process MIDI continue message - continue playing from the current song position
 void handleContinue(void){
   rp2040.idleOtherCore();  // so core 1 doesn't also modify state machine
   controlstate=RUNNING; // put core 1 in playing state
@@ -377,6 +486,7 @@ void setup() {
   #ifdef SERIAL_DEBUG
     Serial.begin(115200);
   #endif
+  BOOTMARK(BOOT_SETUP)
   DEBUG_LN("Initialising 0...");
 
   pinMode(A_MUX_0, OUTPUT);    // encoder mux addresses
@@ -417,6 +527,7 @@ void setup() {
   display.display();
 #endif
   displaytimer=millis(); // reset display blanking timer
+  BOOTMARK(BOOT_DISPLAY)
 
   TinyUSBDevice.clearConfiguration();
   TinyUSBDevice.setManufacturerDescriptor("h4rf4n");
@@ -438,41 +549,44 @@ void setup() {
   // Initialize MIDI, and listen to all MIDI channels
   // This will also call usb_midi's begin()
   MidiUSB.begin(MIDI_CHANNEL_OMNI);
+  MidiUSB.turnThruOff(); // the library echoes every input by default - thru is done by midithru.h
 
 #ifdef SERIAL_MIDI
   MidiSerial.begin(MIDI_CHANNEL_OMNI);
+  MidiSerial.turnThruOff();
 #endif
 
   // attach MIDI message handler functions
-//  MIDI.setHandleNoteOn(handlenoteOn);
-//  MIDI.setHandleNoteOff(handlenoteOff);
+  // notes from either port are recorded - see recorder.h
+  MidiUSB.setHandleNoteOn(handleNoteOn);
+  MidiUSB.setHandleNoteOff(handleNoteOff);
+#ifdef SERIAL_MIDI
+  MidiSerial.setHandleNoteOn(handleNoteOn);
+  MidiSerial.setHandleNoteOff(handleNoteOff);
+#endif
+  // a dump can be restored from either port - see sysex.h
+  MidiUSB.setHandleSystemExclusive(handleSysEx);
+#ifdef SERIAL_MIDI
+  MidiSerial.setHandleSystemExclusive(handleSysEx);
+#endif
 
   MidiUSB.setHandleClock(handleClock);
   MidiUSB.setHandleStop(handleStop);
   MidiUSB.setHandleStart(handleStart);
   MidiUSB.setHandleContinue(handleContinue);
+  MidiUSB.setHandleSongPosition(handleSongPosition);
 
-  display.setCursor(0, 35); 
-  display.print("Initializing USB... ");
-  #ifdef OLED_DISPLAY
-  display.display();
-  #endif
-
-#ifdef SERIAL_MIDI
-  // wait for usb device to mount. if it times out, do not use midi over USB 
-  useMidiUSB = TinyUSBDevice.mounted();
-  int32_t t0 = millis();
-  while( !useMidiUSB && millis()-t0 < USB_MIDI_TIMEOUT) {    
-    delay(1);
-    useMidiUSB = TinyUSBDevice.mounted();
-  }
-#else
-  // wait until device mounted
-  while( !TinyUSBDevice.mounted() ) delay(1);
-#endif
+  setthru(); // thru routes from the menu settings
+  // we don't wait for USB to enumerate - core 1 attaches the USB port whenever it mounts, see usbhotplug()
+  for (uint8_t track=0; track<NTRACKS;++track) rngseed(track,seeds[track]);
+  BOOTMARK(BOOT_MIDI)
+  peripheralsready=true; // core 1 can start
 
   display.fillScreen(BLACK);
   displaytimer=millis(); // reset display blanking timer
+#ifdef SERIAL_DEBUG
+  ramreport();
+#endif
 /*
    // start sequencer and set callbacks
   seq.begin(TEMPO, steps);
@@ -491,6 +605,18 @@ void loop() {
   if ((millis()-displaytimer) > DISPLAY_BLANK_MS) {
     UI_state=DISPLAYOFF;
   } 
+#ifdef SERIAL_DEBUG
+  static int32_t statstimer; 
+  logflush(); // print what core 1 logged
+  bootreport();
+  if ((millis()-statstimer) > 5000) { // report sequencer load every few seconds
+    Serial.printf("%d tracks clocktick %u us max %u us notes late max %u us hung notes %u log drops %u input drops %u sysex errors %u\n",NTRACKS,(unsigned)ticktime_us,(unsigned)ticktime_max_us,
+      (unsigned)emitlate_max_us,(unsigned)hungnotes,(unsigned)logdrops,(unsigned)inputdrops,(unsigned)sysexerrors);
+    xipreport();
+    midireport();
+    statstimer=millis();
+  }
+#endif
 /*
   if ((millis()-displaytimer) > 500) { // debug printing
     // Serial.printf("step= %d val=%d \n",edited_step,edited_val);
@@ -501,6 +627,7 @@ void loop() {
   if (shift && !menumode) { // enter menu mode
     display.fillScreen(BLACK); // erase screen
     topmenuindex=UIpage*NTRACKS+current_track; // link text menus to graphics page
+    if (topmenuindex >= (int16_t)(NUM_MAIN_MENUS)) topmenuindex=current_track; // overview has no menu of its own - use the note menu
     drawtopmenu(topmenuindex); // repaint the menu for the current sequencer
     drawsubmenus();
     menumode=TRUE; // shift button toggles onscreen menus
@@ -512,6 +639,12 @@ void loop() {
   }
 
 
+  if (recordflush() && !menumode && (UI_state != DISPLAYOFF) && (UI_state != DORMANT)) UI_state=UIpages[UIpage]; // show what was recorded
+  if (restoredone) { // every lane may have changed
+    restoredone=false;
+    if (!menumode && (UI_state != DISPLAYOFF) && (UI_state != DORMANT)) UI_state=UIpages[UIpage];
+  }
+
   if (menumode) {
     domenus();  // call the text menu state machine
     displaytimer=millis(); // reset display blanking timer
@@ -522,7 +655,7 @@ void loop() {
     switch (UI_state) {
       case NOTE_DRAW:
         drawheader("Note");
-        drawnotes(notes[current_track]);
+        drawnotes(notes[current_track],NOTE_LANE);
         UI_state=NOTE_EDIT;
         break;
       case NOTE_EDIT:
@@ -531,123 +664,142 @@ void loop() {
           edited_val=notes[current_track].val[edited_step-1];
           int16_t nameindex=constrain(edited_val+notes[current_track].root,0,127)%12;
           int16_t octave=constrain(edited_val+notes[current_track].root,0,127)/12;
-          display.setCursor(6*6,0);  // display which note was changed
-          display.printf(":%d %d %s%d    \n",edited_step,edited_val,notenames[nameindex],octave); 
+          blitf(6*6,0,":%d %d %s%d    ",edited_step,edited_val,notenames[nameindex],octave);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         }
-        updateindex(notes[current_track]); // show the index on screen
+        updateindex(notes[current_track],NOTE_LANE); // show the index on screen
         updateseqlen(notes[current_track]);
         break;
 
       case GATE_DRAW:
         drawheader("Gate");
-        drawbars(gates[current_track]);
+        drawbars(gates[current_track],GATE_LANE);
         UI_state=GATE_EDIT;
         break;
       case GATE_EDIT:
         edited_step=editbars(&gates[current_track]);
         if (edited_step) {  // show the gate value
           edited_val=gates[current_track].val[edited_step-1];
-          display.setCursor(6*6,0);  
-          display.printf(":%d %d%%  ",edited_step,edited_val*100/GATERANGE); 
+          blitf(6*6,0,":%d %d%%  ",edited_step,edited_val*100/GATERANGE);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         }         
-        updateindex(gates[current_track]); // show the index on screen
+        updateindex(gates[current_track],GATE_LANE); // show the index on screen
         updateseqlen(gates[current_track]);
         break;  
 
       case VELOCITY_DRAW:
         drawheader("Velocity");
-        drawbars(velocities[current_track]);
+        drawbars(velocities[current_track],VELOCITY_LANE);
         UI_state=VELOCITY_EDIT;
         break;
       case VELOCITY_EDIT:
         edited_step=editbars(&velocities[current_track]);
         if (edited_step) {  // show the velocity value
           edited_val=velocities[current_track].val[edited_step-1];
-          display.setCursor(10*6,0);  
-          display.printf(":%d %d%% ",edited_step,edited_val*100/VELOCITYRANGE); 
+          blitf(10*6,0,":%d %d%% ",edited_step,edited_val*100/VELOCITYRANGE);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         }  
-        updateindex(velocities[current_track]); // show the index on screen
+        updateindex(velocities[current_track],VELOCITY_LANE); // show the index on screen
         updateseqlen(velocities[current_track]);
         break;  
 
       case OFFSET_DRAW:  // offsets added to the note sequence
         drawheader("Offset");
-        drawnotes(offsets[current_track]);
+        drawnotes(offsets[current_track],OFFSET_LANE);
         UI_state=OFFSET_EDIT;
         break;
       case OFFSET_EDIT:
         edited_step=editnotes(&offsets[current_track]); // must call by reference to change the structure
         if (edited_step) {  // show the note index and degree in scale
           edited_val=offsets[current_track].val[edited_step-1];
-          display.setCursor(8*6,0);  // display which note was changed
-          display.printf(":%d %d  ",edited_step,edited_val); 
+          blitf(8*6,0,":%d %d  ",edited_step,edited_val);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         }        
-        updateindex(offsets[current_track]); // show the index on screen
+        updateindex(offsets[current_track],OFFSET_LANE); // show the index on screen
         updateseqlen(offsets[current_track]);
         break;
 
       case PROBABILITY_DRAW:
         drawheader("Probability");
-        drawbars(probability[current_track]);
+        drawbars(probability[current_track],PROBABILITY_LANE,eucmask[current_track]); // steps outside the euclidean rhythm show as off
         UI_state=PROBABILITY_EDIT;
         break;
       case PROBABILITY_EDIT:
-        edited_step=editbars(&probability[current_track]);
+        edited_step=editbars(&probability[current_track],eucmask[current_track]);
         if (edited_step) {  // show the probability
           edited_val=probability[current_track].val[edited_step-1];
-          display.setCursor(13*6,0);  // display which note was changed
-          display.printf(":%d %3d%%",edited_step,edited_val*100/PROBABILITYRANGE); 
+          blitf(13*6,0,":%d %3d%%",edited_step,edited_val*100/PROBABILITYRANGE);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         } 
-        updateindex(probability[current_track]); // show the index on screen
-        updateseqlen(probability[current_track]);
+        updateindex(probability[current_track],PROBABILITY_LANE,eucmask[current_track]); // show the index on screen
+        updateseqlen(probability[current_track],eucmask[current_track]);
         break;  
 
       case RATCHET_DRAW:
         drawheader("Ratchets");
-        drawbars(ratchets[current_track]);
+        drawbars(ratchets[current_track],RATCHET_LANE);
         UI_state=RATCHET_EDIT;
         break;
       case RATCHET_EDIT:
         edited_step=editbars(&ratchets[current_track]);
         if (edited_step) {  // show the number of ratchets
           edited_val=ratchets[current_track].val[edited_step-1];
-          display.setCursor(10*6,0);  
-          display.printf(":%d %d   ",edited_step,edited_val); 
+          blitf(10*6,0,":%d %d   ",edited_step,edited_val);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         }        
-        updateindex(ratchets[current_track]); // show the index on screen
+        updateindex(ratchets[current_track],RATCHET_LANE); // show the index on screen
         updateseqlen(ratchets[current_track]);
         break; 
 
       case MOD_DRAW:
         drawheader("Mod");
-        drawbars(mods[current_track]);
+        drawbars(mods[current_track],MOD_LANE);
         UI_state=MOD_EDIT;
         break;
       case MOD_EDIT:
         edited_step=editbars(&mods[current_track]);
         if (edited_step) {  // show the number of ratchets
           edited_val=mods[current_track].val[edited_step-1];
-          display.setCursor(5*6,0);  
-          display.printf(":%d %d   ",edited_step,edited_val); 
+          blitf(5*6,0,":%d %d   ",edited_step,edited_val);
           display.display();
           displaytimer=millis(); // reset display blanking timer
         }        
-        updateindex(mods[current_track]); // show the index on screen
+        updateindex(mods[current_track],MOD_LANE); // show the index on screen
         updateseqlen(mods[current_track]);
         break; 
 
+      case TIMING_DRAW:  // per step timing offsets
+        drawheader("Timing");
+        drawnotes(timing[current_track],TIMING_LANE);
+        UI_state=TIMING_EDIT;
+        break;
+      case TIMING_EDIT:
+        edited_step=editnotes(&timing[current_track]);
+        if (edited_step) {  // show the offset in % of a step
+          edited_val=timing[current_track].val[edited_step-1];
+          blitf(8*6,0,":%d %d%%   ",edited_step,edited_val*50/TIMINGRANGE);
+          display.display();
+          displaytimer=millis(); // reset display blanking timer
+        }        
+        updateindex(timing[current_track],TIMING_LANE); // show the index on screen
+        updateseqlen(timing[current_track]);
+        break; 
+
+      case OVERVIEW_DRAW:  // playheads of all the tracks
+        drawheader("Overview");
+        drawoverview();
+        UI_state=OVERVIEW_EDIT;
+        break;
+      case OVERVIEW_EDIT:  // nothing to edit - just follow the playheads
+        updateoverview();
+        break;
+
       case DISPLAYOFF:
         display.fillScreen(BLACK); // protect OLED from burning in
         display.display(); 
@@ -684,17 +836,46 @@ void loop() {
 // second core setup
 // second core dedicated to clock and MIDI processing
 void setup1() {
-  delay (1000); // wait for main core to start up peripherals
+  while (!peripheralsready) delay(1); // wait for main core to start up peripherals
+  BOOTMARK(BOOT_CORE1)
+}
+
+// USB mount and unmount are runtime events - the USB port is attached to or detached from the output router
+// so plugging into a computer mid-song just works
+void usbhotplug(void) {
+  bool mounted=TinyUSBDevice.mounted();
+  if (mounted == useMidiUSB) return;
+  resetport(PORT_USB,micros()); // nothing queued for the old connection goes out on the new one
+  for (uint8_t track=0; track<NTRACKS;++track) lastCC[PORT_USB][track]=-1; // send the current CC values again
+  useMidiUSB=mounted;
+  LOG(LOG_USB,mounted,0,0)
+  if (mounted) BOOTMARK(BOOT_USB)
 }
 
 // second core dedicated to clocks and note on/off for timing accuracy - graphical UI causes redraw delays etc
 // implemented as a simple state machine
 // start button toggles sequencers on and off
 // shift + start button resyncs sequencers
-void loop1(){
-  MidiUSB.read(); // read any new MIDI messages
+void __not_in_flash_func(loop1)(){
+  uint32_t tick=songtick;
+  uint32_t misses=xipmisses();
+  usbhotplug();
+  // read any new MIDI messages - each goes thru the handlers and then on to the thru routes
+  for (uint8_t n=0; (n < MIDI_READ_MAX) && MidiUSB.read();++n) {
+    midithru(PORT_USB,MidiUSB.getType() | ((MidiUSB.getType() < 0xF0) ? MidiUSB.getChannel()-1 : 0),MidiUSB.getData1(),MidiUSB.getData2());
+  }
+#ifdef SERIAL_MIDI
+  for (uint8_t n=0; (n < MIDI_READ_MAX) && MidiSerial.read();++n) { // keyboard on the DIN port
+    midithru(PORT_SERIAL,MidiSerial.getType() | ((MidiSerial.getType() < 0xF0) ? MidiSerial.getChannel()-1 : 0),MidiSerial.getData1(),MidiSerial.getData2());
+  }
+#endif
+  if (useMIDIclock) do_midiclock(); // internal ticks between MIDI clocks
+  dispatchevents(micros()); // send any notes scheduled between clock ticks
+  flushmidi(); // send any MIDI output that is due
+  sysexpump(); // and a piece of a SysEx dump if the port has time
   switch (controlstate) {
     case IDLE:
+      findhung(); // nothing should be sounding now
       if (startbutton && shift) sync_sequencers(); // start all sequencers at beginning
       if (startbutton && !shift) controlstate= STARTUP;
       break;
@@ -728,5 +909,9 @@ void loop1(){
     default:
       controlstate=IDLE;
   }
+  if (songtick != tick) {
+    misses=xipmisses()-misses;
+    if (misses > xipmiss_max) xipmiss_max=misses;
+  }
 }
 
@@ -0,0 +1,81 @@
+// deferred debug logging
+// printf and USB serial on core 1 would add their time to every note so core 1 never formats anything
+// it writes a fixed size binary record - a format number, a timestamp and three numbers - into a ring buffer
+// core 0 turns the records into text and prints them from loop() when it gets round to it
+// one writer (core 1) and one reader (core 0) so the ring needs no locks. if it fills up records are dropped
+// and counted rather than making core 1 wait
+
+#define LOG_SIZE 128  // records - must be a power of 2
+#define LOG_PRINT_MAX 8  // records printed per loop() so a burst of notes doesn't hold up the UI
+
+// add a format here and its text in logformats[]
+enum LOGFORMATS {LOG_NOTEON,LOG_NOTEOFF,LOG_USB,NUM_LOGFORMATS};
+const char * const logformats[NUM_LOGFORMATS] = {
+  "Noteon ch %d pitch %d vel %d",
+  "Noteoff ch %d pitch %d vel %d",
+  "USB mounted %d",
+};
+
+struct logrecord {
+  uint32_t time_us;
+  uint8_t format;  // index into logformats[]
+  int32_t args[3];
+};
+
+logrecord logring[LOG_SIZE];
+volatile uint16_t loghead; // next record to write - only core 1 changes it
+volatile uint16_t logtail; // next record to print - only core 0 changes it
+volatile uint32_t logdrops; // records lost because core 0 fell behind
+
+// core 1 only - a handful of stores, no formatting
+void __not_in_flash_func(logwrite)(uint8_t format, int32_t a, int32_t b, int32_t c) {
+  uint16_t head=loghead;
+  if ((uint16_t)(head-logtail) >= LOG_SIZE) {
+    ++logdrops;
+    return;
+  }
+  logrecord *r=&logring[head & (LOG_SIZE-1)];
+  r->time_us=micros();
+  r->format=format;
+  r->args[0]=a;
+  r->args[1]=b;
+  r->args[2]=c;
+  __sync_synchronize(); // record is complete before core 0 can see it
+  loghead=head+1;
+}
+
+// core 0 only - print some of the records that are waiting
+void logflush(void) {
+  for (uint8_t n=0; (n < LOG_PRINT_MAX) && (logtail != loghead);++n) {
+    __sync_synchronize(); // see the record core 1 finished before it moved loghead
+    const logrecord *r=&logring[logtail & (LOG_SIZE-1)];
+    Serial.printf("%10u ",(unsigned)r->time_us);
+    Serial.printf(logformats[r->format],(int)r->args[0],(int)r->args[1],(int)r->args[2]); // int32_t is long on the RP2040
+    Serial.printf("\n");
+    __sync_synchronize(); // done with the record before core 1 can reuse it
+    logtail=logtail+1;
+  }
+}
+
+// boot timeline - micros() at each milestone on either core, printed once the first note has gone out
+enum BOOTMARKS {BOOT_SETUP,BOOT_DISPLAY,BOOT_MIDI,BOOT_CORE1,BOOT_USB,BOOT_FIRSTNOTE,NUM_BOOTMARKS};
+const char * const bootmarknames[NUM_BOOTMARKS] = {"setup","display","MIDI ready","core 1 running","USB mounted","first note"};
+volatile uint32_t bootmarks[NUM_BOOTMARKS]; // 0 until the milestone is reached
+
+// only the first time counts. one store so either core can mark
+void __not_in_flash_func(bootmark)(uint8_t mark) {
+  if (bootmarks[mark] == 0) bootmarks[mark]=micros() | 1; // never 0 - 1us out doesn't matter
+}
+
+// core 0 only - print the timeline once, after the first note
+void bootreport(void) {
+  static bool reported;
+  if (reported || (bootmarks[BOOT_FIRSTNOTE] == 0)) return;
+  reported=true;
+  Serial.printf("boot:");
+  for (uint8_t mark=0; mark<NUM_BOOTMARKS;++mark) {
+    if (bootmarks[mark]) Serial.printf(" %s %u us",bootmarknames[mark],(unsigned)bootmarks[mark]);
+    else Serial.printf(" %s -",bootmarknames[mark]);
+  }
+  Serial.printf("\n");
+}
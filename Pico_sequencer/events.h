@@ -0,0 +1,70 @@
+// timed note events
+// when a step fires its note ons and offs are worked out once and put in this queue with a deadline in us
+// core 1 then only has to compare the earliest deadline with the time to know if anything is due
+// the queue is a binary heap ordered by deadline. no Arduino calls in here so it can be checked on a PC
+
+#define EVENTQ_SIZE (NTRACKS*64) // room for a 16 hit ratchet burst on every track plus the notes still draining
+
+struct timedevent {
+  uint32_t due_us;  // when to send it
+  uint8_t status;   // note on or note off with channel
+  uint8_t pitch;
+  uint8_t velocity;
+  uint8_t track;    // track that made it
+  uint8_t gen;      // note generation - events from after a note was cut short are dropped, see renderstep()
+};
+
+SEQ_STATE timedevent eventq[EVENTQ_SIZE];
+SEQ_STATE uint16_t eventcount; // number of events in the queue
+SEQ_STATE uint16_t eventdrops; // events lost because the queue was full
+
+// true if a should go out before b. at the same time note offs go first so a retriggered pitch isn't cut off
+bool __not_in_flash_func(eventbefore)(const timedevent *a, const timedevent *b) {
+  int32_t diff=(int32_t)(a->due_us-b->due_us);
+  if (diff != 0) return diff < 0;
+  return (a->status & 0xF0) == 0x80;
+}
+
+// add an event to the queue. returns false if the queue is full
+bool __not_in_flash_func(pushevent)(const timedevent *e) {
+  if (eventcount >= EVENTQ_SIZE) {
+    ++eventdrops;
+    return false;
+  }
+  uint16_t i=eventcount++;
+  while (i > 0) { // sift up
+    uint16_t parent=(i-1)/2;
+    if (!eventbefore(e,&eventq[parent])) break;
+    eventq[i]=eventq[parent];
+    i=parent;
+  }
+  eventq[i]=*e;
+  return true;
+}
+
+// remove the earliest event from the queue. returns false if the queue is empty
+bool __not_in_flash_func(popevent)(timedevent *e) {
+  if (eventcount == 0) return false;
+  *e=eventq[0];
+  timedevent last=eventq[--eventcount];
+  uint16_t i=0;
+  for (;;) { // sift down
+    uint16_t child=2*i+1;
+    if (child >= eventcount) break;
+    if ((child+1 < eventcount) && eventbefore(&eventq[child+1],&eventq[child])) ++child;
+    if (!eventbefore(&eventq[child],&last)) break;
+    eventq[i]=eventq[child];
+    i=child;
+  }
+  eventq[i]=last;
+  return true;
+}
+
+// true if the earliest event is due at time now
+bool __not_in_flash_func(eventdue)(uint32_t now) {
+  return (eventcount > 0) && ((int32_t)(eventq[0].due_us-now) <= 0);
+}
+
+void clearevents(void) {
+  eventcount=0;
+}
@@ -19,147 +19,133 @@
 
 
 
-// plot a note on the screen
-// index = position 0-15
-// note_offset = offset from root note - range +-12
-void drawnote(int16_t index,int16_t note_offset) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
-  int y=CANVAS_ORIGIN_Y + CANVAS_HEIGHT/2 - note_offset*2; //
-  display.drawLine(x,y,x+(CANVAS_WIDTH/SEQ_STEPS), y, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
-}
+// step lanes are drawn a pixel column at a time straight into the SSD1306 buffer
+// each screen column is worked out as a 64 bit mask - one bit per row - from the lane values and written into the
+// page bytes under it in one go, so a whole lane is 128 column writes and one transfer to the display
+// an edit or a marker change only redraws the columns of the steps it touches
+// the panel is landscape so only 0 and 180 degree rotation are handled
 
-// erase a note on the screen
-// index = position 0-15
-// note_offset = offset from root note - range +-12
-void undrawnote(int16_t index,int16_t note_offset) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
-  int y=CANVAS_ORIGIN_Y + CANVAS_HEIGHT/2 - note_offset*2; //
-  display.drawLine(x,y,x+(CANVAS_WIDTH/SEQ_STEPS), y, BLACK);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
-}
+#define STEP_WIDTH (CANVAS_WIDTH/SEQ_STEPS)
+#define MARKER_Y (CANVAS_ORIGIN_Y-4) // centre row of the step markers
+#define MARKER_AREA (0x1FULL << (MARKER_Y-2)) // rows of the step and sequence length markers
+#define VALUE_AREA (~0ULL << CANVAS_ORIGIN_Y) // rows of the lane values - the canvas down to the bottom of the screen
 
-// required forward declarations
-void undrawindex(int16_t index, int16_t active = 1);
-void updateseqlen(sequencer seq);
+enum lanestyles {LANE_NOTES,LANE_BARS}; // notes are a line at the value, bars are filled up from the bottom
 
-// draw all the notes in a note sequence
-void drawnotes(sequencer p) {
-  for (int i=0;i< SEQ_STEPS;++i) {
-    drawnote(i,p.val[i]);
-    undrawindex(i,p.active[i]);
-  }
-  updateseqlen(p);
-}
+int16_t shownindex=-1; // step with the play position marker on screen
+int16_t shownlast=-1;  // step with the sequence length marker on screen
 
-// plot a bar on the screen
-// index = position 0-15
-// val - unscaled height of bar
-// max - max value of val - used to scale val to the screen
+// core 0's copy of the playheads core 1 publishes - see readplayheads(). the lanes' own index is core 1's
+int8_t uiplayheads[NTRACKS][NUM_LANES];
+uint32_t uiplayheadseq=1; // odd so the first read always copies
 
-void drawbar(int16_t index,int16_t val, int16_t max) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
-  int y=map(val,0,max,CANVAS_ORIGIN_Y + CANVAS_HEIGHT,CANVAS_ORIGIN_Y); //
-  int height=CANVAS_ORIGIN_Y + CANVAS_HEIGHT-y;
-  display.fillRect(x,y,(CANVAS_WIDTH/SEQ_STEPS), height, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+uint64_t reverse64(uint64_t v) {
+  uint64_t r=0;
+  for (uint8_t i=0; i<8;++i, v>>=8) r=(r << 8) | reversebits(v & 0xFF);
+  return r;
 }
 
-void undrawbar(int16_t index,int16_t val, int16_t max) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
-  int y=map(val,0,max,CANVAS_ORIGIN_Y + CANVAS_HEIGHT,CANVAS_ORIGIN_Y);
-  int height=CANVAS_ORIGIN_Y + CANVAS_HEIGHT-y;
-  display.fillRect(x,y,(CANVAS_WIDTH/SEQ_STEPS), height, BLACK);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+// write one screen column. rows that are set in area get bits, the others are left alone
+void blitcolumn(int16_t x, uint64_t bits, uint64_t area) {
+  if (display.getRotation() == 2) {
+    x=SCREEN_WIDTH-1-x;
+    bits=reverse64(bits) >> (64-SCREEN_HEIGHT);
+    area=reverse64(area) >> (64-SCREEN_HEIGHT);
+  }
+  uint8_t *b=display.getBuffer()+x;
+  for (uint8_t page=0; page<SCREEN_HEIGHT/8;++page, b+=SCREEN_WIDTH, bits>>=8, area>>=8) {
+    if (area & 0xFF) *b=(*b & ~(uint8_t)area) | (bits & area);
+  }
 }
 
-// draw all the notes in a note sequence
-void drawbars(sequencer p) {
-  for (int i=0;i< SEQ_STEPS;++i) {
-    drawbar(i,p.val[i],p.max);
-    undrawindex(i,p.active[i]);
+// row of a note line. values are + or - from the middle of the canvas, 2 pixels apart
+uint64_t noterow(int16_t val) {
+  int16_t y=CANVAS_ORIGIN_Y + CANVAS_HEIGHT/2 - val*2;
+  return ((y >= 0) && (y < SCREEN_HEIGHT)) ? 1ULL << y : 0;
+}
+
+// pixels of the values in screen column x
+uint64_t valuecolumn(const sequencer &seq, lanestyles style, int16_t x) {
+  int16_t step=x/STEP_WIDTH;
+  if (style == LANE_NOTES) {
+    uint64_t bits=noterow(seq.val[step]);
+    if ((x%STEP_WIDTH == 0) && step) bits|=noterow(seq.val[step-1]); // each note line runs one pixel into the next step
+    return bits;
   }
-  updateseqlen(p);
+  int16_t top=map(seq.val[step],0,seq.max,CANVAS_ORIGIN_Y + CANVAS_HEIGHT,CANVAS_ORIGIN_Y);
+  return (~0ULL << top) & ~(~0ULL << (CANVAS_ORIGIN_Y + CANVAS_HEIGHT)); // bar from the value down to the bottom of the canvas
 }
 
-// plot sequence length on the screen
-// len = last sequence position 0-15
-void drawseqlen(int16_t len) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*len+7;
-  int y=CANVAS_ORIGIN_Y -6; //
-  display.drawLine(x,y,x, y+4, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+// pixels of the markers in screen column x - LED emulation
+// the playing step has a filled circle, or a ring if it is off. other steps have a dot if they are on
+// mask is ANDed with the steps that are on - used to show the euclidean rhythm on the probability page
+uint64_t markercolumn(const sequencer &seq, uint16_t mask, int16_t x) {
+  int16_t step=x/STEP_WIDTH;
+  int16_t dx=x%STEP_WIDTH-4; // from the centre of the marker
+  bool active=bitRead(seq.active & mask,step);
+  uint64_t bits=0;
+  if (step == shownindex) {
+    if (abs(dx) <= 2) bits=(abs(dx) == 2) ? 0x07ULL << (MARKER_Y-1) : 0x1FULL << (MARKER_Y-2); // radius 2 circle
+    if (!active && (abs(dx) <= 1)) bits&=~(0x07ULL << (MARKER_Y-1));
+  }
+  else if (active && (dx == 0)) bits=1ULL << MARKER_Y;
+  if ((step == shownlast) && (dx == 3)) bits|=MARKER_AREA; // sequence length - a line at the right of the last step
+  return bits;
 }
 
-void undrawseqlen(int16_t len) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*len+7;
-  int y=CANVAS_ORIGIN_Y -6; //
-  display.drawLine(x,y,x, y+4, BLACK);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+// redraw the markers of one step
+void drawmarkers(const sequencer &seq, uint16_t mask, int16_t step) {
+  if ((step < 0) || (step >= SEQ_STEPS)) return;
+  for (int16_t x=step*STEP_WIDTH; x<(step+1)*STEP_WIDTH;++x) blitcolumn(x,markercolumn(seq,mask,x),MARKER_AREA);
 }
 
-// update the sequence length on the screen (vertical bar)
-void updateseqlen(sequencer seq) {
-  static int16_t last_seqlen = -1; // tracks the sequence length
-  if (seq.last != last_seqlen) { // draw the sequence length marker
-    undrawseqlen(last_seqlen);
-    drawseqlen(seq.last);
-    last_seqlen=seq.last;
-  }
+// redraw the value of one step after an edit. a note line runs into the next step so its first column is redrawn too
+void drawvalue(const sequencer &seq, lanestyles style, int16_t step) {
+  for (int16_t x=step*STEP_WIDTH; (x<=(step+1)*STEP_WIDTH) && (x<CANVAS_WIDTH);++x) blitcolumn(x,valuecolumn(seq,style,x),VALUE_AREA);
 }
 
-// plot index on the screen
-// index = position 0-15
-void drawindex(int16_t index, int16_t active = 1) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index+4;
-  int y=CANVAS_ORIGIN_Y -4; //
-    display.fillCircle(x,y,2, WHITE);
-  if (active==0)
-    // display.fillCircle(x,y,2, BLACK);
-    display.fillRect(x-1,y-1,3,3, BLACK);
-#ifdef OLED_DISPLAY
+// draw a whole lane - values, markers and sequence length
+void drawlane(const sequencer &seq, uint8_t lane, lanestyles style, uint16_t mask = ALL_STEPS) {
+  readplayheads(uiplayheads,&uiplayheadseq);
+  shownindex=uiplayheads[current_track][lane];
+  shownlast=seq.last;
+  for (int16_t x=0; x<CANVAS_WIDTH;++x) blitcolumn(x,valuecolumn(seq,style,x) | markercolumn(seq,mask,x),VALUE_AREA | MARKER_AREA);
   display.display();
-#endif
 }
 
-void undrawindex(int16_t index, int16_t active) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index+4;
-  int y=CANVAS_ORIGIN_Y -4; //
-  display.fillCircle(x,y,2, BLACK);
-  if (active!=0)
-    display.drawPixel(x,y, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+// draw all the notes in a note sequence
+void drawnotes(const sequencer &seq, uint8_t lane) {
+  drawlane(seq,lane,LANE_NOTES);
 }
 
-// update the index on the screen - LED emulation
-void updateindex(sequencer seq) {
-  static int16_t last_index = -1; // tracks the sequencer index
-  if (seq.index != last_index) { // draw the index marker
-    undrawindex(last_index, seq.active[last_index]);
-    drawindex(seq.index, seq.active[seq.index]);
-    last_index=seq.index;
+// draw all the bars in a sequence
+// mask is ANDed with the step markers - used to show the euclidean rhythm on the probability page
+void drawbars(const sequencer &seq, uint8_t lane, uint16_t mask = ALL_STEPS) {
+  drawlane(seq,lane,LANE_BARS,mask);
+}
+
+// update the sequence length on the screen (vertical bar)
+void updateseqlen(const sequencer &seq, uint16_t mask = ALL_STEPS) {
+  if (seq.last != shownlast) {
+    int16_t old=shownlast;
+    shownlast=seq.last;
+    drawmarkers(seq,mask,old);
+    drawmarkers(seq,mask,shownlast);
+    display.display();
   }
 }
 
-// draw/undraw all indexes and sequence length line
-void drawindexes(sequencer p) {
-  for (int i=0;i< SEQ_STEPS;++i) 
-    undrawindex(i, p.active[i]);
-  updateseqlen(p);
+// update the index on the screen - LED emulation
+// only does anything when core 1 has published a step on this lane
+void updateindex(const sequencer &seq, uint8_t lane, uint16_t mask = ALL_STEPS) {
+  readplayheads(uiplayheads,&uiplayheadseq);
+  if (uiplayheads[current_track][lane] != shownindex) {
+    int16_t old=shownindex;
+    shownindex=uiplayheads[current_track][lane];
+    drawmarkers(seq,mask,old);
+    drawmarkers(seq,mask,shownindex);
+    display.display();
+  }
 }
 
 // edit a note sequence
@@ -168,14 +154,14 @@ void drawindexes(sequencer p) {
 // returns 0 or the step that was changed 1-16
 int16_t editnotes(sequencer *seq) {
   int16_t encvalue,edited_step;
+  bool clicked=false;
   edited_step=0;  // 0 means no step changed
   for (int steppos=0; steppos< SEQ_STEPS;++steppos) {  
     if((encvalue=enc[steppos].getValue()) !=0) {
-      undrawnote(steppos,seq->val[steppos]);
       rp2040.idleOtherCore();
       seq->val[steppos]=constrain(seq->val[steppos]+encvalue,-seq->max,seq->max); // values can be + or -
       rp2040.resumeOtherCore();
-      drawnote(steppos,seq->val[steppos]);
+      drawvalue(*seq,LANE_NOTES,steppos);
       edited_step=steppos+1; // if value changed return its index +1
     }
     ClickEncoder::Button button = enc[steppos].getButton();
@@ -185,31 +171,28 @@ int16_t editnotes(sequencer *seq) {
       rp2040.resumeOtherCore();
     }
     if (button==ClickEncoder::Clicked) { // activate or deactivate a step with single click
-      int16_t active = 1-seq->active[steppos];
-      if (seq->active[steppos]>-1) {
-        rp2040.idleOtherCore();
-        seq->active[steppos] = active;
-        rp2040.resumeOtherCore();
-        if (seq->index!=steppos)
-          undrawindex(steppos, active);
-      }
+      seq->active^=1 << steppos; // one store so core 1 doesn't have to stop
+      drawmarkers(*seq,ALL_STEPS,steppos);
+      clicked=true;
     }
   }
+  if (clicked) display.display(); // value edits go out with the readout the caller draws
   return edited_step;
 }
 
 // edit a bar graph type sequence - gates, velocity etc
 // returns 0 or the step that was changed 1-16
-int16_t editbars(sequencer *seq) {
+// mask is ANDed with the step markers like drawbars()
+int16_t editbars(sequencer *seq, uint16_t mask = ALL_STEPS) {
   int16_t encvalue,edited_step;
+  bool clicked=false;
   edited_step=0;
   for (int steppos=0; steppos< SEQ_STEPS;++steppos) {  
     if((encvalue=enc[steppos].getValue()) !=0) {
-      undrawbar(steppos,seq->val[steppos],seq->max);
       rp2040.idleOtherCore();
       seq->val[steppos]=constrain(seq->val[steppos]+encvalue,0,seq->max); // values can be 0 to max     
       rp2040.resumeOtherCore();
-      drawbar(steppos,seq->val[steppos],seq->max);
+      drawvalue(*seq,LANE_BARS,steppos);
       edited_step=steppos+1;
     }
     ClickEncoder::Button button = enc[steppos].getButton();
@@ -219,23 +202,63 @@ int16_t editbars(sequencer *seq) {
       rp2040.resumeOtherCore();
     }
     if (button==ClickEncoder::Clicked) { // activate or deactivate a step with single click
-      int16_t active = 1-seq->active[steppos];
-      if (seq->active[steppos]>-1) {
-        rp2040.idleOtherCore();
-        seq->active[steppos] = active;
-        rp2040.resumeOtherCore();
-        if (seq->index!=steppos)
-          undrawindex(steppos, active);
-      }
+      seq->active^=1 << steppos; // one store so core 1 doesn't have to stop
+      drawmarkers(*seq,mask,steppos);
+      clicked=true;
     }
   }
+  if (clicked) display.display(); // value edits go out with the readout the caller draws
   return edited_step;
 }
 
-void drawheader(String text){
+// overview page - the playheads of every track at once
+// a row per track with a block on the gate lane's playing step and a line under each step that is on
+// steps past the end of the track are left blank. only redrawn when a track's gate lane steps
+#define OVERVIEW_Y 10 // top of the first track
+#define OVERVIEW_ROW (((SCREEN_HEIGHT-OVERVIEW_Y)/NTRACKS > 12) ? 12 : (SCREEN_HEIGHT-OVERVIEW_Y)/NTRACKS) // pixels per track
+#define OVERVIEW_X 14 // left of step 1 - the track numbers go in front when the rows are tall enough
+#define OVERVIEW_STEP ((CANVAS_WIDTH-OVERVIEW_X)/SEQ_STEPS)
+#define OVERVIEW_AREA (~0ULL << OVERVIEW_Y)
+
+int8_t overviewshown[NTRACKS]; // gate lane playheads on screen
+
+uint64_t overviewcolumn(int16_t x) {
+  int16_t step=(x-OVERVIEW_X)/OVERVIEW_STEP;
+  if ((x < OVERVIEW_X) || (step >= SEQ_STEPS) || ((x-OVERVIEW_X)%OVERVIEW_STEP >= OVERVIEW_STEP-2)) return 0; // gap between steps
+  uint64_t bits=0;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if ((step < gates[track].first) || (step > gates[track].last)) continue;
+    int16_t y=OVERVIEW_Y+track*OVERVIEW_ROW;
+    if (step == overviewshown[track]) bits|=((1ULL << (OVERVIEW_ROW-1))-1) << y;
+    else if (bitRead(gates[track].active | fillmask[track],step)) bits|=1ULL << (y+OVERVIEW_ROW-2);
+  }
+  return bits;
+}
+
+void drawoverview(void) {
+  readplayheads(uiplayheads,&uiplayheadseq);
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    overviewshown[track]=uiplayheads[track][GATE_LANE];
+    if (OVERVIEW_ROW >= 8) blitf(0,OVERVIEW_Y+track*OVERVIEW_ROW+(OVERVIEW_ROW-8)/2,"%d",track+1);
+  }
+  for (int16_t x=OVERVIEW_X; x<CANVAS_WIDTH;++x) blitcolumn(x,overviewcolumn(x),OVERVIEW_AREA);
+  display.display();
+}
+
+void updateoverview(void) {
+  if (!readplayheads(uiplayheads,&uiplayheadseq)) return;
+  bool moved=false;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if (uiplayheads[track][GATE_LANE] != overviewshown[track]) moved=true;
+  }
+  if (!moved) return; // only other lanes stepped
+  for (uint8_t track=0; track<NTRACKS;++track) overviewshown[track]=uiplayheads[track][GATE_LANE];
+  for (int16_t x=OVERVIEW_X; x<CANVAS_WIDTH;++x) blitcolumn(x,overviewcolumn(x),OVERVIEW_AREA);
+  display.display();
+}
+
+void drawheader(const char *text){
 //  display.clearDisplay();
   display.fillScreen(BLACK);
-  display.setCursor(0,0);
-  display.print(text+" ");
-  display.print(current_track+1);
+  blitf(0,0,"%s %d",text,current_track+1);
 }
\ No newline at end of file
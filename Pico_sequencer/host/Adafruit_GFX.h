@@ -0,0 +1,39 @@
+// host stand-in for Adafruit GFX - a 1 bit canvas with the drawing calls the sequencer uses and the classic 5x7 font
+#pragma once
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h) {}
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color)=0;
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {drawLine(x,y,x+w-1,y,color);}
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {drawLine(x,y,x,y+h-1,color);}
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void fillScreen(uint16_t color) {fillRect(0,0,WIDTH,HEIGHT,color);}
+  void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg);
+  size_t write(uint8_t c);
+  using Print::write;
+  void setCursor(int16_t x, int16_t y) {cursor_x=x; cursor_y=y;}
+  void setTextColor(uint16_t c) {textcolor=textbgcolor=c;}  // same colours means transparent background
+  void setTextColor(uint16_t c, uint16_t bg) {textcolor=c; textbgcolor=bg;}
+  void setTextSize(uint8_t s) {(void)s;}
+  void setTextWrap(bool w) {wrap=w;}
+  // the SSD1306 stand-in applies 0 and 180 degrees to its buffer like the real driver. 90 and 270 are not supported
+  void setRotation(uint8_t r) {rotation=r&3;}
+  uint8_t getRotation(void) {return rotation;}
+  int16_t width(void) {return WIDTH;}
+  int16_t height(void) {return HEIGHT;}
+  int16_t getCursorX(void) {return cursor_x;}
+  int16_t getCursorY(void) {return cursor_y;}
+protected:
+  const int16_t WIDTH,HEIGHT;
+  int16_t cursor_x=0,cursor_y=0;
+  uint16_t textcolor=1,textbgcolor=1;
+  uint8_t rotation=0;
+  bool wrap=true;
+};
@@ -0,0 +1,30 @@
+// host stand-in for the SSD1306 OLED driver
+// the frame buffer has the same page layout and rotation as the real one. display() hands it to the sim the way
+// the user sees it on the mounted panel, which dumps frames and times how long the UI took to show an input
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+#define INVERSE SSD1306_INVERSE
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_EXTERNALVCC 0x01
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi, int8_t rst_pin);
+  ~Adafruit_SSD1306();
+  bool begin(uint8_t vcs=SSD1306_SWITCHCAPVCC, uint8_t addr=0, bool reset=true, bool periphBegin=true);
+  void display(void);
+  void clearDisplay(void);
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  uint8_t *getBuffer(void) {return buffer;}
+private:
+  uint8_t *buffer;
+  uint8_t *frame;  // buffer turned back the right way up for the sim
+};
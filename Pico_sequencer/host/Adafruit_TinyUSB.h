@@ -0,0 +1,20 @@
+// host stand-in for the TinyUSB device stack. the USB port counts as mounted unless the sim says otherwise
+#pragma once
+
+#include <Arduino.h>
+
+class Adafruit_USBD_Device {
+public:
+  bool clearConfiguration(void) {return true;}
+  void setManufacturerDescriptor(const char *s) {(void)s;}
+  void setProductDescriptor(const char *s) {(void)s;}
+  bool mounted(void);
+  bool suspended(void) {return false;}
+  void task(void) {}
+};
+extern Adafruit_USBD_Device TinyUSBDevice;
+
+class Adafruit_USBD_MIDI {
+public:
+  bool begin(void) {return true;}
+};
@@ -0,0 +1,100 @@
+// host stand-in for the Arduino core - just enough of the API for the sequencer to run as a Linux program
+// see sim.cpp for how it is built and run
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define bitRead(value,bit) (((value) >> (bit)) & 1)
+#define bitSet(value,bit) ((value) |= (1UL << (bit)))
+#define bitClear(value,bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value,bit,bitvalue) ((bitvalue) ? bitSet(value,bit) : bitClear(value,bit))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// time since the program started, wraps the same way as on the Pico
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// virtual GPIO - inputs set to INPUT_PULLUP read high until the sim script pulls them low
+#define SIM_NUM_PINS 30
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+class String : public std::string {
+public:
+  String(const char *s="") : std::string(s) {}
+  String(const std::string &s) : std::string(s) {}
+};
+inline String operator+(const String &a, const char *b) {return String((const std::string &)a+b);}
+
+// text output - print/printf are built on write() like the real thing
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c)=0;
+  size_t write(const uint8_t *buf, size_t len) {size_t n=0; while (len--) n+=write(*buf++); return n;}
+  size_t print(const char *s) {return write((const uint8_t *)s,strlen(s));}
+  size_t print(const String &s) {return print(s.c_str());}
+  size_t print(char c) {return write((uint8_t)c);}
+  size_t print(int n) {return printf("%d",n);}
+  size_t print(unsigned int n) {return printf("%u",n);}
+  size_t print(long n) {return printf("%ld",n);}
+  size_t print(unsigned long n) {return printf("%lu",n);}
+  size_t println(void) {return print("\n");}
+  template <typename T> size_t println(T v) {size_t n=print(v); return n+println();}
+  size_t printf(const char *format, ...) __attribute__((format(printf,2,3)));
+};
+
+// Serial goes to stdout, Serial1 is the DIN MIDI UART which the MIDI stand-in handles itself
+class SerialPort : public Print {
+public:
+  SerialPort(FILE *f) : out(f) {}
+  void begin(unsigned long baud) {(void)baud;}
+  operator bool() {return true;}
+  size_t write(uint8_t c) {if (out) fputc(c,out); return 1;}
+  using Print::write;
+  int available(void) {return 0;}
+  int read(void) {return -1;}
+  void flush(void) {if (out) fflush(out);}
+private:
+  FILE *out;
+};
+typedef SerialPort HardwareSerial;
+extern SerialPort Serial;
+extern SerialPort Serial1;
+
+// core 0 and core 1 run as threads. idleOtherCore() from core 0 waits for core 1 to finish its current loop1()
+// and holds it there till resumeOtherCore(). core 0 is never paused - that would deadlock two threads that each
+// hold the other, and nothing core 1 does from MIDI handlers needs it
+class RP2040 {
+public:
+  void idleOtherCore(void);
+  void resumeOtherCore(void);
+  uint32_t getCycleCount(void);
+};
+extern RP2040 rp2040;
+
+#define __not_in_flash_func(f) f
+#define __not_in_flash(group)
@@ -0,0 +1,37 @@
+// host stand-in for ClickEncoder - virtual encoders turned and clicked by the sim script
+// the sketch includes "Clickencoder.h" so on a case sensitive file system this shadows the real ClickEncoder.h
+// values are in detents, the quadrature decoding and acceleration are not simulated
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+class ClickEncoder {
+public:
+  typedef enum Button_e {
+    Open=0,
+    Closed,
+    Pressed,
+    Held,
+    Released,
+    Clicked,
+    DoubleClicked
+  } Button;
+
+  ClickEncoder(uint8_t A, uint8_t B, uint8_t BTN=-1, uint8_t stepsPerNotch=1, bool active=LOW) {
+    (void)A; (void)B; (void)BTN; (void)stepsPerNotch; (void)active;
+  }
+  void service(void) {}
+  int16_t getValue(void) {return delta.exchange(0);}
+  Button getButton(void) {return (Button)button.exchange(Open);}
+  void setDoubleClickEnabled(const bool &d) {(void)d;}
+  void setAccelerationEnabled(const bool &a) {(void)a;}
+
+  // sim input
+  void simturn(int16_t detents) {delta+=detents;}
+  void simbutton(Button b) {button=b;}
+
+private:
+  std::atomic<int16_t> delta{0};
+  std::atomic<uint8_t> button{Open};
+};
@@ -0,0 +1,76 @@
+// host stand-in for the Arduino MIDI library
+// output is handed to the sim which logs it with a timestamp. input comes from the sim script and goes thru
+// the same handler callbacks as the real library when the sketch calls read(). the library's soft thru is on
+// until the sketch turns it off, the same as on the device, and the sim counts anything it echoes
+#pragma once
+
+#include <Arduino.h>
+
+#define MIDI_CHANNEL_OMNI 0
+#define MIDI_CHANNEL_OFF 17
+
+namespace midi {
+  typedef uint8_t DataByte;
+  typedef uint8_t Channel;
+  enum MidiType : uint8_t {
+    InvalidType=0x00,NoteOff=0x80,NoteOn=0x90,AfterTouchPoly=0xA0,ControlChange=0xB0,ProgramChange=0xC0,
+    AfterTouchChannel=0xD0,PitchBend=0xE0,SystemExclusive=0xF0,TimeCodeQuarterFrame=0xF1,SongPosition=0xF2,
+    SongSelect=0xF3,TuneRequest=0xF6,SystemExclusiveEnd=0xF7,Clock=0xF8,Tick=0xF9,Start=0xFA,Continue=0xFB,
+    Stop=0xFC,ActiveSensing=0xFE,SystemReset=0xFF
+  };
+}
+
+#define SIM_MIDI_SYSEX_SIZE 128
+
+class MidiInterface {
+public:
+  MidiInterface(const char *portname);
+  const char *name;  // port name for the log
+
+  void begin(midi::Channel ch=1) {(void)ch;}
+  bool read(void);  // processes one message from the sim input queue
+  void send(midi::MidiType type, midi::DataByte d1, midi::DataByte d2, midi::Channel ch);
+  void sendNoteOn(midi::DataByte note, midi::DataByte vel, midi::Channel ch) {send(midi::NoteOn,note,vel,ch);}
+  void sendNoteOff(midi::DataByte note, midi::DataByte vel, midi::Channel ch) {send(midi::NoteOff,note,vel,ch);}
+  void sendControlChange(midi::DataByte cc, midi::DataByte val, midi::Channel ch) {send(midi::ControlChange,cc,val,ch);}
+  void sendRealTime(midi::MidiType type);
+  void sendSongPosition(unsigned beats);
+  void sendSysEx(unsigned length, const byte *data, bool containsBoundaries=false);
+  void turnThruOff(void) {thru=false;}
+
+  midi::MidiType getType(void) {return type;}
+  midi::Channel getChannel(void) {return channel;}
+  midi::DataByte getData1(void) {return data1;}
+  midi::DataByte getData2(void) {return data2;}
+  const byte *getSysExArray(void) {return sysex;}
+  unsigned getSysExArrayLength(void) {return sysexlen;}
+
+  void setHandleNoteOn(void (*f)(byte,byte,byte)) {noteon_cb=f;}
+  void setHandleNoteOff(void (*f)(byte,byte,byte)) {noteoff_cb=f;}
+  void setHandleControlChange(void (*f)(byte,byte,byte)) {cc_cb=f;}
+  void setHandleSystemExclusive(void (*f)(byte *,unsigned)) {sysex_cb=f;}
+  void setHandleSongPosition(void (*f)(unsigned)) {songpos_cb=f;}
+  void setHandleClock(void (*f)(void)) {clock_cb=f;}
+  void setHandleStart(void (*f)(void)) {start_cb=f;}
+  void setHandleContinue(void (*f)(void)) {continue_cb=f;}
+  void setHandleStop(void (*f)(void)) {stop_cb=f;}
+
+private:
+  midi::MidiType type=midi::InvalidType;
+  midi::Channel channel=0;
+  midi::DataByte data1=0,data2=0;
+  byte sysex[SIM_MIDI_SYSEX_SIZE];
+  unsigned sysexlen=0;
+  bool thru=true;  // like the library every message read is echoed back out of the port until turnThruOff()
+  void (*noteon_cb)(byte,byte,byte)=nullptr;
+  void (*noteoff_cb)(byte,byte,byte)=nullptr;
+  void (*cc_cb)(byte,byte,byte)=nullptr;
+  void (*sysex_cb)(byte *,unsigned)=nullptr;
+  void (*songpos_cb)(unsigned)=nullptr;
+  void (*clock_cb)(void)=nullptr;
+  void (*start_cb)(void)=nullptr;
+  void (*continue_cb)(void)=nullptr;
+  void (*stop_cb)(void)=nullptr;
+};
+
+#define MIDI_CREATE_INSTANCE(Type, SerialPort, Name) MidiInterface Name(#Name);
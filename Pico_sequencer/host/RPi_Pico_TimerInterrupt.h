@@ -0,0 +1,17 @@
+// host stand-in for the Pico timer interrupt library
+// the "interrupt" handler runs on its own thread at the requested interval
+#pragma once
+
+#include <Arduino.h>
+
+struct repeating_timer {
+  int64_t delay_us;
+};
+
+typedef bool (*pico_timer_callback)(struct repeating_timer *t);
+
+class RPI_PICO_Timer {
+public:
+  RPI_PICO_Timer(uint8_t timerNo) {(void)timerNo;}
+  bool attachInterruptInterval(unsigned long interval_us, pico_timer_callback callback);
+};
@@ -0,0 +1,2 @@
+// host stand-in for the SPI library - nothing uses SPI on the host
+#pragma once
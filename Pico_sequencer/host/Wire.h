@@ -0,0 +1,10 @@
+// host stand-in for the I2C library - the display stand-in doesn't talk to anything
+#pragma once
+
+class TwoWire {
+public:
+  bool setSDA(int pin) {(void)pin; return true;}
+  bool setSCL(int pin) {(void)pin; return true;}
+  void begin(void) {}
+};
+extern TwoWire Wire;
@@ -0,0 +1,206 @@
+// host batch renderer - renders lots of pattern variants as fast as the CPUs allow and sums up each one
+// the sequencer engine headers are compiled with SEQ_STATE as thread_local so every thread has its own complete
+// engine. each worker thread renders one variant after another and resetengine() puts its engine back to the
+// power up defaults in between like the real thing, and time is simulated - a variant renders in a few ms no
+// matter how many bars it is
+// include this in one host program and write a setup function that edits the engine for each variant. see variants.cpp
+
+#pragma once
+
+#include <Arduino.h>
+#include <MIDI.h>
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define TRUE 1
+#define FALSE 0
+#ifndef NTRACKS
+#define NTRACKS 4
+#endif
+#define PPQN 96
+#define MIDI_PPQN 24
+#define SEQ_STATE thread_local
+
+#include "../tracks.h"
+
+// the settings the sketch normally provides - same defaults
+SEQ_STATE uint8_t MIDIchannel[NTRACKS] = {FOR_EACH_TRACK(TRACK_NUMBER)};
+SEQ_STATE uint8_t CCchannel[NTRACKS] = {FOR_EACH_TRACK(TRACK_NUMBER)};
+SEQ_STATE uint16_t trackenabled = 1;
+SEQ_STATE uint16_t mod_enabled;
+SEQ_STATE uint16_t mod_ramp;
+SEQ_STATE uint8_t bpm = 120;
+int16_t current_track; // only used by the menu handlers
+
+// what a render produced
+struct rendersummary {
+  uint32_t notes;  // note ons
+  uint32_t ccs;  // CC messages
+  uint32_t ticks;  // clock ticks rendered
+  uint8_t lowest,highest;  // pitch range, both 0 if nothing played
+  uint8_t distinct;  // number of different pitches
+  uint8_t maxpoly;  // most notes sounding at once
+  uint8_t velocity_avg;
+  uint32_t hash;  // FNV-1a of every note message and its time - same hash, same performance
+};
+
+SEQ_STATE uint32_t rendertime;  // simulated time in us
+SEQ_STATE rendersummary *rendering;  // summary for the variant this thread is rendering
+SEQ_STATE uint32_t velocitysum;
+SEQ_STATE uint8_t sounding;
+SEQ_STATE uint8_t pitchesheard[16];  // one bit per MIDI note
+
+unsigned long micros(void) {
+  return rendertime;
+}
+
+RP2040 rp2040;
+void RP2040::idleOtherCore(void) {}
+void RP2040::resumeOtherCore(void) {}
+uint32_t RP2040::getCycleCount(void) {return 0;}
+
+void renderhash(uint8_t status, uint8_t data1, uint8_t data2) {
+  uint8_t bytes[7]={(uint8_t)rendertime,(uint8_t)(rendertime >> 8),(uint8_t)(rendertime >> 16),(uint8_t)(rendertime >> 24),status,data1,data2};
+  for (uint8_t i=0; i<sizeof(bytes);++i) rendering->hash=(rendering->hash ^ bytes[i])*16777619u;
+}
+
+#include "../midiout.h"
+
+// a host test can watch every message the engine sends on each port
+SEQ_STATE void (*porttap)(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2);
+
+// a message went out on a port - it counts against the port's bandwidth like queuemsg() on the device
+void portsent(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2) {
+  tickbytes[port]+=msglength(status);
+  if (porttap) porttap(port,status,data1,data2);
+}
+
+// MIDI output goes straight into the summary. notes are tracked as if they went out on the USB port
+// and like queueall() they go out on both ports
+void noteOn(byte channel, byte pitch, byte velocity) {
+  rendersummary *r=rendering;
+  for (uint8_t port=0; port<NUM_PORTS;++port) portsent(port,midi::NoteOn | channel,pitch,velocity);
+  renderhash(midi::NoteOn | channel,pitch,velocity);
+  noteactive(PORT_USB,midi::NoteOn | channel,pitch,velocity);
+  if (r->notes == 0) r->lowest=r->highest=pitch;
+  if (pitch < r->lowest) r->lowest=pitch;
+  if (pitch > r->highest) r->highest=pitch;
+  if (!bitRead(pitchesheard[pitch >> 3],pitch & 7)) {
+    bitSet(pitchesheard[pitch >> 3],pitch & 7);
+    ++r->distinct;
+  }
+  ++r->notes;
+  velocitysum+=velocity;
+  if (++sounding > r->maxpoly) r->maxpoly=sounding;
+}
+
+void noteOff(byte channel, byte pitch, byte velocity) {
+  for (uint8_t port=0; port<NUM_PORTS;++port) portsent(port,midi::NoteOff | channel,pitch,velocity);
+  renderhash(midi::NoteOff | channel,pitch,velocity);
+  noteactive(PORT_USB,midi::NoteOff | channel,pitch,velocity);
+  if (sounding) --sounding;
+}
+
+bool noteOffPort(uint8_t port, byte channel, byte pitch, byte velocity) {
+  if (port != PORT_USB) return false;
+  noteOff(channel,pitch,velocity);
+  return true;
+}
+
+void flushmidi(void) {}
+
+bool controlChangePort(uint8_t port, byte channel, byte control, byte value) {
+  portsent(port,midi::ControlChange | channel,control,value);
+  if (port == PORT_USB) {  // count each CC once, not once per port
+    ++rendering->ccs;
+    renderhash(midi::ControlChange | channel,control,value);
+  }
+  return true;
+}
+
+#include "../scales.h"
+#include "../events.h"
+#include "../prng.h"
+#include "../seq.h"
+
+// every SEQ_STATE variable in the engine headers and the render bookkeeping above - add new engine state here
+// or a variant can see what the last one left behind. rendering and porttap belong to the caller and are kept
+#define ENGINE_STATE(X) \
+  X(MIDIchannel) X(CCchannel) X(trackenabled) X(mod_enabled) X(mod_ramp) X(bpm) \
+  X(rendertime) X(velocitysum) X(sounding) X(pitchesheard) \
+  X(tickbytes) X(activenotes) X(hungnotes) X(midiq) X(midistats) X(thrustats) X(port_busy_until) \
+  X(current_scale) X(quantshift) X(quantfor) X(quantsel) \
+  X(eventq) X(eventcount) X(eventdrops) \
+  X(rngkey) \
+  X(clocktimer) X(active_note) X(active_velocity) X(tie) X(noteoff_due) X(notegen) X(cut_us) X(prerendered) X(swing) \
+  X(ratchetgate) X(ratchetramp) X(seeds) X(eucmask) X(fillmask) X(fillmode) X(outputdelay) X(nextroot) \
+  X(midisubticks) X(ticktime_us) X(ticktime_max_us) X(emitcount) X(emitlate_us) X(emitlate_max_us) X(renderlead_us) \
+  X(lastCC) X(ramp_rr) X(notes) X(offsets) X(gates) X(ratchets) X(velocities) X(probability) X(timing) X(mods) \
+  X(songtick) X(playheadseq) X(playheads) X(playheadsmoved) X(heldkeys)
+
+#define ENGINE_FIELD(v) std::remove_volatile_t<decltype(::v)> v;
+#define ENGINE_SAVE(v) memcpy(&enginedefaults.v,(const void *)&::v,sizeof(::v));
+#define ENGINE_RESTORE(v) memcpy((void *)&::v,&enginedefaults.v,sizeof(::v));
+
+struct enginestate {
+  ENGINE_STATE(ENGINE_FIELD)
+};
+
+static enginestate enginedefaults;  // the power up engine, copied once from a thread that hasn't touched its own
+
+// put this thread's engine back to the power up defaults - patterns, settings, the event heap, the MIDI queues,
+// the random number generator and the song position all start over
+void resetengine(void) {
+  static std::once_flag saved;
+  std::call_once(saved,[] {std::thread([] {ENGINE_STATE(ENGINE_SAVE)}).join();});
+  ENGINE_STATE(ENGINE_RESTORE)
+}
+
+// called on the rendering thread to set up that thread's engine for a variant - edit notes[], gates[] etc directly
+typedef void (*variantsetup)(uint32_t variant, void *arg);
+
+// render one variant for a number of clock ticks from the top on this thread's engine, reset first
+void rendervariant(uint32_t variant, variantsetup setup, void *arg, uint32_t ticks, rendersummary *out) {
+  resetengine();
+  *out={};
+  rendering=out;
+  out->hash=2166136261u;
+  setup(variant,arg);
+  sync_sequencers();
+  uint32_t clockperiod=clockperiod_us();
+  for (uint32_t tick=0; tick<=ticks;++tick) {
+    uint32_t tick_us=tick*clockperiod;
+    while (eventdue(tick_us)) { // notes between ticks go out at their own times
+      if ((int32_t)(eventq[0].due_us-rendertime) > 0) rendertime=eventq[0].due_us;
+      dispatchevents(rendertime);
+    }
+    rendertime=tick_us;
+    if (tick < ticks) clocktick(clockperiod,tick_us);
+  }
+  all_notes_off();
+  out->ticks=ticks;
+  out->velocity_avg=out->notes ? velocitysum/out->notes : 0;
+}
+
+// render count variants spread over threads worker threads, 0 for one per CPU
+// out[variant] gets the summary for each. results don't depend on the number of threads
+void renderbatch(uint32_t count, variantsetup setup, void *arg, uint32_t ticks, rendersummary *out, unsigned threads=0) {
+  if (threads == 0) threads=std::thread::hardware_concurrency();
+  if (threads == 0) threads=1;
+  std::atomic<uint32_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned i=0; i<threads;++i) {
+    workers.emplace_back([&] {
+      for (;;) {
+        uint32_t variant=next++;
+        if (variant >= count) break;
+        rendervariant(variant,setup,arg,ticks,&out[variant]);
+      }
+    });
+  }
+  for (auto &w : workers) w.join();
+}
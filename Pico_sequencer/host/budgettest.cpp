@@ -0,0 +1,176 @@
+// checks the CC ramp bandwidth budget in midiout.h and domods() against 4 tracks that saturate the DIN port
+// the tracks play 32nd notes at 240 BPM, overlapping so some steps fill the DIN port's share of a MIDI clock with
+// notes, some leave room for a few ramp points and some for all of them. every track has a ramping mod lane and USB
+// always has room to spare. each tick's messages are taken apart per port and checked: step CCs always go out,
+// ramp points only go out on MIDI clocks, a MIDI clock's ramp points never take a port past its share once the notes
+// that go out during that MIDI clock are counted, and a port that can't take every ramp point shares them out evenly
+//
+// build from the Pico_sequencer directory:
+//   g++ -std=gnu++17 -O2 -pthread -Ihost host/budgettest.cpp -o budgettest
+// run:
+//   ./budgettest      exits with 1 if any check fails
+
+#define TESTNAME "budgettest"
+
+#include "batch.h"
+#include "check.h"
+
+#include <algorithm>
+
+#define TEST_BPM 240
+#define TEST_BARS 8
+
+// what went out on a port during one tick, in order
+struct tickrecord {
+  uint16_t bytes[NUM_PORTS];  // everything so far
+  uint16_t used[NUM_PORTS];  // bytes before the first ramp point
+  uint8_t ramps[NUM_PORTS][NTRACKS];  // ramp points per track
+  uint8_t steps[NUM_PORTS][NTRACKS];  // step CCs per track
+  bool stepping[NTRACKS];  // mod lane steps this tick
+};
+
+static tickrecord rec;
+
+// a MIDI clock's ramp points and the bytes sent ahead of them in the tick
+struct clockrecord {
+  uint32_t us;
+  uint16_t used[NUM_PORTS];
+  uint16_t ramps[NUM_PORTS];
+};
+
+static std::vector<clockrecord> clocks;
+static std::vector<uint32_t> notetimes[NUM_PORTS];  // when each note message went out
+
+// mod track a CC belongs to, -1 if none
+static int8_t modtrack(uint8_t status, uint8_t control) {
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if ((status == (midi::ControlChange | (CCchannel[track]-1))) && (control == mods[track].root)) return track;
+  }
+  return -1;
+}
+
+static void tap(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2) {
+  (void)data2;
+  if (((status & 0xF0) == midi::NoteOn) || ((status & 0xF0) == midi::NoteOff)) notetimes[port].push_back(rendertime);
+  int8_t track=((status & 0xF0) == midi::ControlChange) ? modtrack(status,data1) : -1;
+  if (track >= 0) {
+    if (rec.stepping[track]) {
+      bool anyramp=false;
+      for (uint8_t t=0; t<NTRACKS;++t) anyramp|=rec.ramps[port][t] != 0;
+      check(!anyramp,"step CC sent after a ramp point");
+      ++rec.steps[port][track];
+    }
+    else {
+      bool first=true;
+      for (uint8_t t=0; t<NTRACKS;++t) first&=rec.ramps[port][t] == 0;
+      if (first) rec.used[port]=rec.bytes[port];
+      ++rec.ramps[port][track];
+    }
+  }
+  rec.bytes[port]+=msglength(status);
+}
+
+// the budget sums themselves
+static void checkmaths(void) {
+  uint32_t midiclock=clockperiod_us()*CLOCKS_PER_MIDI_CLOCK;
+  check(port_bytes_per_tick(SERIAL_MIDI_BYTES_PER_SEC,midiclock) == 24,"DIN bytes per MIDI clock at 240 BPM");
+  check(msgbudget(SERIAL_MIDI_BYTES_PER_SEC,midiclock,8*MIDI_MSG_BYTES) == 0,"DIN ramp budget after 8 notes");
+  check(msgbudget(USB_MIDI_BYTES_PER_SEC,midiclock,8*MIDI_MSG_BYTES) == 116,"USB ramp budget after 8 notes");
+  check(msgbudget(SERIAL_MIDI_BYTES_PER_SEC,midiclock,1000) == 0,"budget with the port over full");
+  check(msgbudget(SERIAL_MIDI_BYTES_PER_SEC,midiclock,0) == 8,"DIN ramp budget on an idle port");
+  for (uint16_t used=0; used<30;++used) {
+    check(msgbudget(SERIAL_MIDI_BYTES_PER_SEC,midiclock,used+1) <= msgbudget(SERIAL_MIDI_BYTES_PER_SEC,midiclock,used),"budget grows with use");
+  }
+}
+
+// 32nd notes - track 1 on every step, track 2 every other step, track 3 every 4th and track 4 every 8th
+// the mod lanes ramp between 127 and 0 every bar
+static void saturate(void) {
+  bpm=TEST_BPM;
+  trackenabled=(1 << NTRACKS)-1;
+  mod_enabled=(1 << NTRACKS)-1;
+  mod_ramp=(1 << NTRACKS)-1;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    gates[track].divider=0;  // 8x
+    gates[track].active=0;
+    for (uint8_t step=0; step<SEQ_STEPS;++step) {
+      if ((step % (1 << track)) == 0) gates[track].active|=1 << step;
+      mods[track].val[step]=(step & 1) ? 0 : MODRANGE;
+    }
+    mods[track].divider=10;  // /4 - a bar at a time
+  }
+}
+
+int main(void) {
+  rendersummary summary={};
+  rendering=&summary;
+  porttap=tap;
+  saturate();
+  checkmaths();
+  sync_sequencers();
+
+  uint32_t clockperiod=clockperiod_us();
+  uint32_t midiclock=clockperiod*CLOCKS_PER_MIDI_CLOCK;
+  uint32_t ticks=TEST_BARS*4*PPQN;
+  uint32_t rampsper[NUM_PORTS][NTRACKS]={};
+  uint32_t starved=0,partial=0;  // MIDI clocks where DIN had no room or room for only some of the ramps USB sent
+  for (uint32_t tick=0; tick<ticks;++tick) {
+    uint32_t tick_us=tick*clockperiod;
+    while (eventdue(tick_us)) { // notes between ticks aren't part of the tick's budget
+      if ((int32_t)(eventq[0].due_us-rendertime) > 0) rendertime=eventq[0].due_us;
+      dispatchevents(rendertime);
+    }
+    rec={};
+    rendertime=tick_us;
+    for (uint8_t track=0; track<NTRACKS;++track) rec.stepping[track]=mods[track].clockticks == 1;
+    bool onmidiclock=(songtick%CLOCKS_PER_MIDI_CLOCK) == 0;
+    clocktick(clockperiod,tick_us);
+
+    uint16_t ramps[NUM_PORTS]={};
+    for (uint8_t port=0; port<NUM_PORTS;++port) {
+      for (uint8_t track=0; track<NTRACKS;++track) {
+        ramps[port]+=rec.ramps[port][track];
+        rampsper[port][track]+=rec.ramps[port][track];
+        check(!rec.stepping[track] || (rec.steps[port][track] == 1),"step CC not sent");
+        check(rec.ramps[port][track] <= 1,"more than one ramp point for a track in a tick");
+      }
+      if (!onmidiclock) {
+        check(ramps[port] == 0,"ramp point between MIDI clocks");
+        continue;
+      }
+    }
+    if (onmidiclock) clocks.push_back({tick_us,{rec.used[PORT_USB],rec.used[PORT_SERIAL]},{ramps[PORT_USB],ramps[PORT_SERIAL]}});
+    if (ramps[PORT_USB] > ramps[PORT_SERIAL]) {
+      if (ramps[PORT_SERIAL] == 0) ++starved;
+      else ++partial;
+    }
+  }
+  all_notes_off();
+
+  // notes are rendered ahead and go out at their own times so count the ones that went out during each MIDI clock
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    for (const clockrecord &c : clocks) {
+      auto from=std::lower_bound(notetimes[port].begin(),notetimes[port].end(),c.us);
+      auto to=std::lower_bound(notetimes[port].begin(),notetimes[port].end(),c.us+midiclock);
+      uint16_t used=c.used[port]+(to-from)*MIDI_MSG_BYTES;
+      check(c.ramps[port] <= msgbudget(port_bytes_per_sec[port],midiclock,used),"ramp points over what the notes left");
+    }
+  }
+
+  // the scenario has to actually saturate DIN or the checks above prove nothing
+  check(starved > 0,"DIN never ran out of room for ramps");
+  check(partial > 0,"DIN never had room for only some ramps");
+  uint32_t most=0,least=UINT32_MAX,usb=0,din=0;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    most=std::max(most,rampsper[PORT_SERIAL][track]);
+    least=std::min(least,rampsper[PORT_SERIAL][track]);
+    usb+=rampsper[PORT_USB][track];
+    din+=rampsper[PORT_SERIAL][track];
+  }
+  check(usb > din,"USB should carry more ramp points than DIN");
+  check(most-least <= 2,"DIN ramp points not shared evenly between tracks");
+
+  printf("budgettest: %u tracks %u BPM %u ticks, %u notes, ramp points USB %u DIN %u (per track %u-%u), DIN starved %u partial %u MIDI clocks\n",
+    NTRACKS,TEST_BPM,ticks,summary.notes,usb,din,least,most,starved,partial);
+  return testresult();
+}
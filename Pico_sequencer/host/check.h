@@ -0,0 +1,34 @@
+// pass/fail bookkeeping for the host tests
+// define TESTNAME before including this. check() prints what failed, the first MAX_FAILS_SHOWN of them, and
+// testresult() prints the verdict and gives main() its exit code - 1 if any check failed
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef TESTNAME
+#error define TESTNAME before including check.h
+#endif
+
+#define MAX_FAILS_SHOWN 20
+
+static uint32_t failures;
+
+__attribute__((format(printf,2,3)))
+static void check(bool ok, const char *what, ...) {
+  if (ok) return;
+  if (failures++ >= MAX_FAILS_SHOWN) return;
+  va_list args;
+  va_start(args,what);
+  printf(TESTNAME ": FAIL ");
+  vprintf(what,args);
+  printf("\n");
+  va_end(args);
+}
+
+static int testresult(void) {
+  printf(TESTNAME ": %s\n",failures ? "FAIL" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+// checks the SysEx dump and restore round trip against a known good dump
+// every lane and setting is given a pattern, dumped and compared byte for byte with host/golden.syx. then the
+// engine gets a different pattern, the dump is restored and dumped again - the two dumps have to match. a damaged
+// chunk has to stop the restore without changing anything, and values out of range have to come back in range
+// the sketch is compiled in like the sim but nothing runs on its own - the test calls the dump code directly
+//
+// build from the Pico_sequencer directory:
+//   g++ -std=gnu++17 -O2 -pthread -Ihost host/dumptest.cpp host/hal.cpp -o dumptest
+// run from the Pico_sequencer directory:
+//   ./dumptest [-w]      exits with 1 if any check fails
+// -w writes a new host/golden.syx. only do that when the dump format changes on purpose, and bump SYSEX_VERSION
+
+#define TESTNAME "dumptest"
+
+#include "../Pico_sequencer.ino"
+#include "sim.h"
+#include "check.h"
+
+#include <string.h>
+#include <vector>
+
+#define GOLDEN "host/golden.syx"
+
+typedef std::vector<uint8_t> sysexdata;
+
+// the sketch's output has nowhere to go
+void simframe(const uint8_t *buf, int16_t w, int16_t h) {(void)buf; (void)w; (void)h;}
+void simmidiout(const char *port, const uint8_t *msg, uint16_t len) {(void)port; (void)msg; (void)len;}
+void simsoftthru(const char *port) {(void)port;}
+
+// small generator so a seed always makes the same pattern
+static uint32_t state;
+static int16_t pick(int16_t lo, int16_t hi) {
+  state=state*1664525u+1013904223u;
+  return lo+(int16_t)((state >> 16) % (hi-lo+1));
+}
+
+// something in every field the dump carries, all of it in range
+static void pattern(uint32_t seed) {
+  state=seed;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    for (uint8_t lane=0; lane<NUM_LANES;++lane) {
+      sequencer *seq=getlane(track,lane);
+      bool signedlane=(lane == NOTE_LANE) || (lane == OFFSET_LANE) || (lane == TIMING_LANE);
+      for (uint8_t step=0; step<SEQ_STEPS;++step) seq->val[step]=pick(signedlane ? -seq->max : 0,seq->max);
+      seq->active=pick(0,0x7FFF) | (pick(0,1) << 15);
+      seq->stepmode=pick(FORWARD,RANDOM);
+      seq->first=pick(0,3);
+      seq->last=pick(seq->first,SEQ_STEPS-1);
+      seq->euclen=pick(1,16);
+      seq->eucbeats=pick(1,16);
+      seq->divider=pick(0,25);
+      seq->root=pick(1,115);
+    }
+    mods[track].root=pick(0,127);
+    probability[track].root=pick(0,15);
+    MIDIchannel[track]=pick(1,16);
+    CCchannel[track]=pick(1,16);
+    current_scale[track]=pick(0,9);
+    swing[track]=pick(0,SWINGRANGE);
+    ratchetgate[track]=pick(1,20)*5;
+    ratchetramp[track]=pick(-20,20)*5;
+    seeds[track]=pick(0,9999);
+    eucmask[track]=pick(0,0x7FFF);
+    fillmode[track]=pick(0,3);
+    fillmask[track]=pick(0,0x7FFF);
+    outputdelay[track]=pick(-OUTPUTDELAY_MAX,OUTPUTDELAY_MAX);
+    transposechan[track]=pick(0,16);
+  }
+  trackenabled=pick(0,(1 << NTRACKS)-1);
+  mod_enabled=pick(0,(1 << NTRACKS)-1);
+  mod_ramp=pick(0,(1 << NTRACKS)-1);
+  bpm=pick(20,240);
+  useMIDIclock=pick(0,1);
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    thrudest[port]=pick(0,3);
+    thruchannel[port]=pick(0,16);
+  }
+}
+
+// the whole dump as it would go out over USB
+static sysexdata dump(void) {
+  sysexdata out;
+  uint8_t msg[DUMP_MSG_MAX];
+  for (int16_t n=0; uint16_t len=dumpmessage(n,msg);++n) out.insert(out.end(),msg,msg+len);
+  return out;
+}
+
+// feed a .syx worth of messages to the restore one at a time like handleSysEx() gets them
+static void restore(const sysexdata &syx) {
+  size_t start=0;
+  for (size_t i=0; i<syx.size();++i) {
+    if (syx[i] == midi::SystemExclusive) start=i;
+    if (syx[i] == midi::SystemExclusiveEnd) handleSysEx((byte *)&syx[start],i-start+1);
+  }
+}
+
+static bool readfile(const char *name, sysexdata *data) {
+  FILE *f=fopen(name,"rb");
+  if (!f) return false;
+  int c;
+  while ((c=fgetc(f)) != EOF) data->push_back(c);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool write=(argc > 1) && (strcmp(argv[1],"-w") == 0);
+  pattern(1);
+  sysexdata first=dump();
+
+  if (write) {
+    FILE *f=fopen(GOLDEN,"wb");
+    if (!f || (fwrite(first.data(),1,first.size(),f) != first.size())) {
+      printf("dumptest: can't write %s\n",GOLDEN);
+      return 1;
+    }
+    fclose(f);
+    printf("dumptest: wrote %s, %zu bytes\n",GOLDEN,first.size());
+    return 0;
+  }
+
+  sysexdata golden;
+  check(readfile(GOLDEN,&golden),"can't read " GOLDEN " - run from the Pico_sequencer directory");
+  check(first == golden,"dump is different from " GOLDEN);
+
+  // a restore puts back exactly what was dumped
+  pattern(2);
+  check(dump() != first,"the second pattern dumps the same as the first");
+  restore(first);
+  check((restoresdone == 1) && (sysexerrors == 0),"restore not accepted");
+  check(dump() == first,"dump after restore is different");
+
+  // a chunk with a damaged data byte is caught by its CRC and the good chunks ahead of it don't go live
+  sysexdata damaged=first;
+  damaged[10+3*(DUMP_MSG_MAX)+20]^=0x01;  // a data byte well inside the 4th chunk
+  pattern(2);
+  sysexdata before=dump();
+  restore(damaged);
+  check((restoresdone == 1) && (sysexerrors == 1),"damaged chunk not caught");
+  check(dump() == before,"a failed restore changed the sequencer");
+
+  // a dump with values no menu or editor allows - its CRCs are good so only the range checks stop them
+  pattern(1);
+  sequencer kept=gates[1];
+  gates[0].val[0]=100;
+  probability[0].val[3]=-5;  // would index past the probability thresholds
+  mods[1].val[0]=-7;
+  notes[0].first=20;
+  notes[2].last=30;
+  notes[1].divider=99;
+  timing[3].stepmode=9;
+  MIDIchannel[1]=40;
+  current_scale[2]=200;
+  outputdelay[3]=2000;
+  seeds[0]=-3;
+  thrudest[PORT_USB]=7;
+  bpm=250;
+  sysexdata wild=dump();
+  pattern(2);
+  restore(wild);
+  check(restoresdone == 2,"restore of out of range values not accepted");
+  check((gates[0].val[0] == GATERANGE) && (probability[0].val[3] == 0) && (mods[1].val[0] == -1),"step value not clamped");
+  check((notes[0].first == SEQ_STEPS-1) && (notes[0].last == SEQ_STEPS-1) && (notes[2].last == SEQ_STEPS-1),"loop points not clamped");
+  check((notes[1].divider == 25) && (timing[3].stepmode == RANDOM),"rate or step mode not clamped");
+  check((MIDIchannel[1] == 16) && (current_scale[2] == 9) && (thrudest[PORT_USB] == 3),"channel, scale or thru not clamped");
+  check((outputdelay[3] == OUTPUTDELAY_MAX) && (seeds[0] == 0) && (bpm == 240),"delay, seed or BPM not clamped");
+  check((gates[1].val[0] == kept.val[0]) && (gates[1].divider == kept.divider) && (gates[1].last == kept.last),"value in range changed");
+
+  printf("dumptest: %u tracks, %zu bytes in %u messages\n",NTRACKS,first.size(),dumpchunks()+1);
+  return testresult();
+}
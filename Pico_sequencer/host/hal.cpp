@@ -0,0 +1,432 @@
+// implementations of the Arduino and library stand-ins for the host simulator
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include <Adafruit_TinyUSB.h>
+#include <MIDI.h>
+#include <RPi_Pico_TimerInterrupt.h>
+#include <Wire.h>
+#include <hardware/structs/xip_ctrl.h>
+#include "sim.h"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+std::atomic<bool> simquit{false};
+std::atomic<bool> simusbmounted{true};
+thread_local uint8_t simcore=0;
+
+static std::vector<std::thread> simthreads;
+
+void simthread(std::thread &&t) {
+  simthreads.push_back(std::move(t));
+}
+
+void simjoin(void) {
+  for (auto &t : simthreads) t.join();
+  simthreads.clear();
+}
+
+// ------------- time -------------
+
+static const std::chrono::steady_clock::time_point simstart=std::chrono::steady_clock::now();
+
+unsigned long micros(void) {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-simstart).count();
+}
+
+unsigned long millis(void) {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-simstart).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  (void)us; // only used for mux settling which the virtual encoders don't need
+}
+
+// ------------- random numbers -------------
+
+static std::minstd_rand simrandom;
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  return simrandom() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return howsmall+random(howbig-howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) simrandom.seed(seed);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x-in_min)*(out_max-out_min)/(in_max-in_min)+out_min;
+}
+
+// ------------- GPIO -------------
+
+static std::atomic<uint8_t> simpins[SIM_NUM_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if ((pin < SIM_NUM_PINS) && (mode == INPUT_PULLUP)) simpins[pin]=HIGH;
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < SIM_NUM_PINS) ? simpins[pin].load() : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < SIM_NUM_PINS) simpins[pin]=val ? HIGH : LOW;
+}
+
+void simpin(uint8_t pin, uint8_t level) {
+  digitalWrite(pin,level);
+}
+
+// ------------- serial -------------
+
+SerialPort Serial(stdout);
+SerialPort Serial1(nullptr);
+
+size_t Print::printf(const char *format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args,format);
+  int len=vsnprintf(buf,sizeof(buf),format,args);
+  va_end(args);
+  if (len < 0) return 0;
+  if (len >= (int)sizeof(buf)) len=sizeof(buf)-1;
+  return write((const uint8_t *)buf,len);
+}
+
+// ------------- cores -------------
+
+static std::mutex core1mutex;  // held by core 1 while it runs loop1() and by core 0 while core 1 is idled
+static std::atomic<int> idlerequests{0};
+
+RP2040 rp2040;
+
+static xip_ctrl_hw_t xip_ctrl;
+xip_ctrl_hw_t *const xip_ctrl_hw=&xip_ctrl;
+
+void RP2040::idleOtherCore(void) {
+  if (simcore != 0) return;
+  ++idlerequests;
+  core1mutex.lock();
+}
+
+void RP2040::resumeOtherCore(void) {
+  if (simcore != 0) return;
+  core1mutex.unlock();
+  --idlerequests;
+}
+
+uint32_t RP2040::getCycleCount(void) {
+  return micros()*133; // 133MHz
+}
+
+void simcore1begin(void) {
+  while (idlerequests > 0) std::this_thread::yield(); // let core 0 in first
+  core1mutex.lock();
+}
+
+void simcore1end(void) {
+  core1mutex.unlock();
+}
+
+// ------------- timer interrupt -------------
+
+bool RPI_PICO_Timer::attachInterruptInterval(unsigned long interval_us, pico_timer_callback callback) {
+  simthread(std::thread([interval_us,callback] {
+    repeating_timer t={(int64_t)interval_us};
+    auto next=std::chrono::steady_clock::now();
+    while (!simquit) {
+      next+=std::chrono::microseconds(interval_us);
+      std::this_thread::sleep_until(next);
+      callback(&t);
+    }
+  }));
+  return true;
+}
+
+// ------------- USB, I2C -------------
+
+Adafruit_USBD_Device TinyUSBDevice;
+TwoWire Wire;
+
+bool Adafruit_USBD_Device::mounted(void) {
+  return simusbmounted;
+}
+
+// ------------- graphics -------------
+
+// classic 5x7 font, one byte per column, LSB at the top. printable ASCII only
+static const uint8_t font5x7[][5] = {
+  {0x00,0x00,0x00,0x00,0x00},{0x00,0x00,0x5F,0x00,0x00},{0x00,0x07,0x00,0x07,0x00},{0x14,0x7F,0x14,0x7F,0x14}, //  !"#
+  {0x24,0x2A,0x7F,0x2A,0x12},{0x23,0x13,0x08,0x64,0x62},{0x36,0x49,0x55,0x22,0x50},{0x00,0x05,0x03,0x00,0x00}, // $%&'
+  {0x00,0x1C,0x22,0x41,0x00},{0x00,0x41,0x22,0x1C,0x00},{0x08,0x2A,0x1C,0x2A,0x08},{0x08,0x08,0x3E,0x08,0x08}, // ()*+
+  {0x00,0x50,0x30,0x00,0x00},{0x08,0x08,0x08,0x08,0x08},{0x00,0x60,0x60,0x00,0x00},{0x20,0x10,0x08,0x04,0x02}, // ,-./
+  {0x3E,0x51,0x49,0x45,0x3E},{0x00,0x42,0x7F,0x40,0x00},{0x42,0x61,0x51,0x49,0x46},{0x21,0x41,0x45,0x4B,0x31}, // 0123
+  {0x18,0x14,0x12,0x7F,0x10},{0x27,0x45,0x45,0x45,0x39},{0x3C,0x4A,0x49,0x49,0x30},{0x01,0x71,0x09,0x05,0x03}, // 4567
+  {0x36,0x49,0x49,0x49,0x36},{0x06,0x49,0x49,0x29,0x1E},{0x00,0x36,0x36,0x00,0x00},{0x00,0x56,0x36,0x00,0x00}, // 89:;
+  {0x08,0x14,0x22,0x41,0x00},{0x14,0x14,0x14,0x14,0x14},{0x00,0x41,0x22,0x14,0x08},{0x02,0x01,0x51,0x09,0x06}, // <=>?
+  {0x32,0x49,0x79,0x41,0x3E},{0x7E,0x11,0x11,0x11,0x7E},{0x7F,0x49,0x49,0x49,0x36},{0x3E,0x41,0x41,0x41,0x22}, // @ABC
+  {0x7F,0x41,0x41,0x22,0x1C},{0x7F,0x49,0x49,0x49,0x41},{0x7F,0x09,0x09,0x01,0x01},{0x3E,0x41,0x41,0x51,0x32}, // DEFG
+  {0x7F,0x08,0x08,0x08,0x7F},{0x00,0x41,0x7F,0x41,0x00},{0x20,0x40,0x41,0x3F,0x01},{0x7F,0x08,0x14,0x22,0x41}, // HIJK
+  {0x7F,0x40,0x40,0x40,0x40},{0x7F,0x02,0x04,0x02,0x7F},{0x7F,0x04,0x08,0x10,0x7F},{0x3E,0x41,0x41,0x41,0x3E}, // LMNO
+  {0x7F,0x09,0x09,0x09,0x06},{0x3E,0x41,0x51,0x21,0x5E},{0x7F,0x09,0x19,0x29,0x46},{0x46,0x49,0x49,0x49,0x31}, // PQRS
+  {0x01,0x01,0x7F,0x01,0x01},{0x3F,0x40,0x40,0x40,0x3F},{0x1F,0x20,0x40,0x20,0x1F},{0x7F,0x20,0x18,0x20,0x7F}, // TUVW
+  {0x63,0x14,0x08,0x14,0x63},{0x03,0x04,0x78,0x04,0x03},{0x61,0x51,0x49,0x45,0x43},{0x00,0x7F,0x41,0x41,0x00}, // XYZ[
+  {0x02,0x04,0x08,0x10,0x20},{0x00,0x41,0x41,0x7F,0x00},{0x04,0x02,0x01,0x02,0x04},{0x40,0x40,0x40,0x40,0x40}, // \]^_
+  {0x00,0x01,0x02,0x04,0x00},{0x20,0x54,0x54,0x54,0x78},{0x7F,0x48,0x44,0x44,0x38},{0x38,0x44,0x44,0x44,0x20}, // `abc
+  {0x38,0x44,0x44,0x48,0x7F},{0x38,0x54,0x54,0x54,0x18},{0x08,0x7E,0x09,0x01,0x02},{0x08,0x14,0x54,0x54,0x3C}, // defg
+  {0x7F,0x08,0x04,0x04,0x78},{0x00,0x44,0x7D,0x40,0x00},{0x20,0x40,0x44,0x3D,0x00},{0x00,0x7F,0x10,0x28,0x44}, // hijk
+  {0x00,0x41,0x7F,0x40,0x00},{0x7C,0x04,0x18,0x04,0x78},{0x7C,0x08,0x04,0x04,0x78},{0x38,0x44,0x44,0x44,0x38}, // lmno
+  {0x7C,0x14,0x14,0x14,0x08},{0x08,0x14,0x14,0x18,0x7C},{0x7C,0x08,0x04,0x04,0x08},{0x48,0x54,0x54,0x54,0x20}, // pqrs
+  {0x04,0x3F,0x44,0x40,0x20},{0x3C,0x40,0x40,0x20,0x7C},{0x1C,0x20,0x40,0x20,0x1C},{0x3C,0x40,0x30,0x40,0x3C}, // tuvw
+  {0x44,0x28,0x10,0x28,0x44},{0x0C,0x50,0x50,0x50,0x3C},{0x44,0x64,0x54,0x4C,0x44},{0x00,0x08,0x36,0x41,0x00}, // xyz{
+  {0x00,0x00,0x7F,0x00,0x00},{0x00,0x41,0x36,0x08,0x00},{0x08,0x04,0x08,0x10,0x08}                           // |}~
+};
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  int16_t dx=abs(x1-x0),sx=x0<x1 ? 1 : -1;
+  int16_t dy=-abs(y1-y0),sy=y0<y1 ? 1 : -1;
+  int16_t err=dx+dy;
+  for (;;) {
+    drawPixel(x0,y0,color);
+    if ((x0 == x1) && (y0 == y1)) break;
+    int16_t e2=2*err;
+    if (e2 >= dy) {err+=dy; x0+=sx;}
+    if (e2 <= dx) {err+=dx; y0+=sy;}
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  drawFastHLine(x,y,w,color);
+  drawFastHLine(x,y+h-1,w,color);
+  drawFastVLine(x,y,h,color);
+  drawFastVLine(x+w-1,y,h,color);
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t j=y; j<y+h;++j)
+    for (int16_t i=x; i<x+w;++i) drawPixel(i,j,color);
+}
+
+void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  for (int16_t y=-r; y<=r;++y)
+    for (int16_t x=-r; x<=r;++x) {
+      int16_t d=x*x+y*y;
+      if ((d <= r*r+r) && (d > r*r-r)) drawPixel(x0+x,y0+y,color);
+    }
+}
+
+void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  for (int16_t y=-r; y<=r;++y)
+    for (int16_t x=-r; x<=r;++x)
+      if (x*x+y*y <= r*r+r) drawPixel(x0+x,y0+y,color);
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg) {
+  if ((c < ' ') || (c > '~')) c='?';
+  const uint8_t *glyph=font5x7[c-' '];
+  for (int8_t i=0; i<6;++i) {
+    uint8_t line=(i < 5) ? glyph[i] : 0; // 6th column is the gap between characters
+    for (int8_t j=0; j<8;++j, line>>=1) {
+      if (line & 1) drawPixel(x+i,y+j,color);
+      else if (bg != color) drawPixel(x+i,y+j,bg);
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursor_x=0;
+    cursor_y+=8;
+  }
+  else if (c != '\r') {
+    if (wrap && (cursor_x+6 > WIDTH)) {
+      cursor_x=0;
+      cursor_y+=8;
+    }
+    drawChar(cursor_x,cursor_y,c,textcolor,textbgcolor);
+    cursor_x+=6;
+  }
+  return 1;
+}
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi, int8_t rst_pin) : Adafruit_GFX(w,h) {
+  (void)twi; (void)rst_pin;
+  buffer=new uint8_t[w*((h+7)/8)]();
+  frame=new uint8_t[w*((h+7)/8)]();
+}
+
+Adafruit_SSD1306::~Adafruit_SSD1306() {
+  delete[] buffer;
+  delete[] frame;
+}
+
+bool Adafruit_SSD1306::begin(uint8_t vcs, uint8_t addr, bool reset, bool periphBegin) {
+  (void)vcs; (void)addr; (void)reset; (void)periphBegin;
+  clearDisplay();
+  return true;
+}
+
+void Adafruit_SSD1306::display(void) {
+  if (rotation != 2) {
+    simframe(buffer,WIDTH,HEIGHT);
+    return;
+  }
+  memset(frame,0,WIDTH*((HEIGHT+7)/8));
+  for (int16_t y=0; y<HEIGHT;++y) {
+    for (int16_t x=0; x<WIDTH;++x) {
+      int16_t bx=WIDTH-1-x, by=HEIGHT-1-y;
+      if ((buffer[bx+(by/8)*WIDTH] >> (by & 7)) & 1) frame[x+(y/8)*WIDTH]|=1 << (y & 7);
+    }
+  }
+  simframe(frame,WIDTH,HEIGHT);
+}
+
+void Adafruit_SSD1306::clearDisplay(void) {
+  memset(buffer,0,WIDTH*((HEIGHT+7)/8));
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if ((x < 0) || (y < 0) || (x >= WIDTH) || (y >= HEIGHT)) return;
+  if (rotation == 2) {
+    x=WIDTH-1-x;
+    y=HEIGHT-1-y;
+  }
+  uint8_t *b=&buffer[x+(y/8)*WIDTH];
+  uint8_t bit=1 << (y & 7);
+  switch (color) {
+    case SSD1306_WHITE: *b|=bit; break;
+    case SSD1306_BLACK: *b&=~bit; break;
+    case SSD1306_INVERSE: *b^=bit; break;
+  }
+}
+
+// ------------- MIDI -------------
+
+struct siminput {
+  MidiInterface *port;
+  uint8_t status,data1,data2;
+  std::vector<uint8_t> sysex;  // whole message F0 to F7 when status is SystemExclusive
+};
+
+static std::mutex inputmutex;
+static std::deque<siminput> inputq;
+
+// function static so ports constructed before this file's globals can still register
+static std::vector<MidiInterface *> &midiports(void) {
+  static std::vector<MidiInterface *> ports;
+  return ports;
+}
+
+MidiInterface::MidiInterface(const char *portname) : name(portname) {
+  midiports().push_back(this);
+}
+
+bool siminject(const char *port, uint8_t status, uint8_t data1, uint8_t data2) {
+  for (MidiInterface *p : midiports()) {
+    if (strcmp(p->name,port) == 0) {
+      std::lock_guard<std::mutex> lock(inputmutex);
+      inputq.push_back({p,status,data1,data2});
+      return true;
+    }
+  }
+  return false;
+}
+
+bool siminjectsysex(const char *port, const uint8_t *msg, uint16_t len) {
+  for (MidiInterface *p : midiports()) {
+    if (strcmp(p->name,port) == 0) {
+      std::lock_guard<std::mutex> lock(inputmutex);
+      inputq.push_back({p,midi::SystemExclusive,0,0,std::vector<uint8_t>(msg,msg+len)});
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MidiInterface::read(void) {
+  siminput in;
+  sysexlen=0;
+  {
+    std::lock_guard<std::mutex> lock(inputmutex);
+    auto it=inputq.begin();
+    while ((it != inputq.end()) && (it->port != this)) ++it;
+    if (it == inputq.end()) return false;
+    in=std::move(*it);
+    inputq.erase(it);
+  }
+  type=(midi::MidiType)((in.status < 0xF0) ? (in.status & 0xF0) : in.status);
+  channel=(in.status < 0xF0) ? (in.status & 0x0F)+1 : 0;
+  data1=in.data1;
+  data2=in.data2;
+  if ((type == midi::NoteOn) && (data2 == 0)) type=midi::NoteOff; // the library treats velocity 0 as note off
+  if (type == midi::SystemExclusive) { // like the library a message too big for the buffer is dropped
+    if (in.sysex.size() > SIM_MIDI_SYSEX_SIZE) return true;
+    sysexlen=in.sysex.size();
+    memcpy(sysex,in.sysex.data(),sysexlen);
+    data1=sysexlen & 0xFF; // the library puts the length in the data bytes
+    data2=sysexlen >> 8;
+  }
+  switch (type) {
+    case midi::NoteOn: if (noteon_cb) noteon_cb(channel,data1,data2); break;
+    case midi::NoteOff: if (noteoff_cb) noteoff_cb(channel,data1,data2); break;
+    case midi::ControlChange: if (cc_cb) cc_cb(channel,data1,data2); break;
+    case midi::SystemExclusive: if (sysex_cb) sysex_cb(sysex,sysexlen); break;
+    case midi::SongPosition: if (songpos_cb) songpos_cb(data1 | (data2 << 7)); break;
+    case midi::Clock: if (clock_cb) clock_cb(); break;
+    case midi::Start: if (start_cb) start_cb(); break;
+    case midi::Continue: if (continue_cb) continue_cb(); break;
+    case midi::Stop: if (stop_cb) stop_cb(); break;
+    default: break;
+  }
+  if (thru) { // the library sends what it read straight back out after the callback
+    if (type == midi::SystemExclusive) sendSysEx(sysexlen,sysex,true);
+    else {
+      uint8_t msg[3]={in.status,in.data1,in.data2};
+      uint8_t kind=in.status & 0xF0;
+      uint16_t len=(in.status >= 0xF0) ? ((in.status == midi::SongPosition) ? 3 : 1) :
+        (((kind == midi::ProgramChange) || (kind == midi::AfterTouchChannel)) ? 2 : 3);
+      simmidiout(name,msg,len);
+    }
+    simsoftthru(name);
+  }
+  return true;
+}
+
+void MidiInterface::send(midi::MidiType type, midi::DataByte d1, midi::DataByte d2, midi::Channel ch) {
+  uint8_t msg[3]={(uint8_t)(type | ((ch-1) & 0x0F)),(uint8_t)(d1 & 0x7F),(uint8_t)(d2 & 0x7F)};
+  uint16_t len=((type == midi::ProgramChange) || (type == midi::AfterTouchChannel)) ? 2 : 3;
+  simmidiout(name,msg,len);
+}
+
+void MidiInterface::sendRealTime(midi::MidiType type) {
+  uint8_t msg=type;
+  simmidiout(name,&msg,1);
+}
+
+void MidiInterface::sendSongPosition(unsigned beats) {
+  uint8_t msg[3]={midi::SongPosition,(uint8_t)(beats & 0x7F),(uint8_t)((beats >> 7) & 0x7F)};
+  simmidiout(name,msg,3);
+}
+
+void MidiInterface::sendSysEx(unsigned length, const byte *data, bool containsBoundaries) {
+  std::vector<uint8_t> msg;
+  if (!containsBoundaries) msg.push_back(midi::SystemExclusive);
+  msg.insert(msg.end(),data,data+length);
+  if (!containsBoundaries) msg.push_back(midi::SystemExclusiveEnd);
+  simmidiout(name,msg.data(),msg.size());
+}
@@ -0,0 +1,14 @@
+// XIP flash cache registers - the host has no flash cache so the counters stay at 0
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t ctrl;
+  volatile uint32_t flush;
+  volatile uint32_t stat;
+  volatile uint32_t ctr_hit;
+  volatile uint32_t ctr_acc;
+} xip_ctrl_hw_t;
+
+extern xip_ctrl_hw_t *const xip_ctrl_hw;
@@ -0,0 +1,277 @@
+// Pico Sequencer host simulator
+// runs the real sketch on Linux - setup()/loop() and setup1()/loop1() on two threads standing in for the two
+// RP2040 cores, with the Arduino core, display, encoders, timer interrupt and MIDI replaced by the stand-ins
+// in this directory. the Arduino IDE doesn't compile anything in host/ so none of this goes into the firmware
+//
+// build from the Pico_sequencer directory:
+//   g++ -std=gnu++17 -O2 -pthread -Ihost host/sim.cpp host/hal.cpp -o picosim
+// run:
+//   ./picosim [-s script] [-t seconds] [-f framedir] [-m midilog] [-x sysexout] [-j max_late_us] [-l max_latency_us]
+//
+// -s plays a session script, one input per line:  <ms> <command> [args]   # comments ok
+//    enc <0-15> <detents>    turn a step encoder          click <0-15>   dclick <0-15>   click/double click it
+//    menu <detents>          turn the menu encoder        menuclick
+//    shift <0|1>             hold/release shift           start <0|1>    hold/release start/stop
+//    track <0|1>             hold/release the menu encoder switch (menu encoder then changes track)
+//    pin <gpio> <0|1>        drive any input pin          usb <0|1>      plug/unplug USB
+//    midi <status> <d1> <d2> MIDI input on the USB port   midiclock <bpm> send MIDI clock, 0 stops
+//    din <status> <d1> <d2>  MIDI input on the DIN port
+//    sysex <file>            send the SysEx messages in a .syx file to the USB port one at a time
+//    end                     stop the run here
+// -t runs for a fixed time instead, default 5 s with no script
+// -f writes every frame that changed to framedir as a PBM image, named by time in us
+// -m logs every MIDI message sent as  <us> <port> <hex bytes>
+// -x writes every SysEx message sent to a .syx file - a dump can be compared with a known good one or played back
+//
+// at the end it reports how late note events went out vs their deadlines on core 1, time from an encoder input to the first changed frame
+// on core 0, MIDI traffic and how long thru messages waited to go out. -j and -l make the run exit with 1 if the worst case is over the limit.
+// the run also exits with 1 if the MIDI library echoed any input - soft thru has to be off
+
+#include "../Pico_sequencer.ino"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static FILE *midilog;
+static FILE *sysexout;
+static const char *framedir;
+static std::mutex framemutex;
+static std::vector<uint8_t> lastframe;
+static uint32_t frames,changedframes;
+static std::atomic<bool> inputpending{false};
+static std::atomic<uint32_t> input_us;  // when the oldest input not yet seen on screen arrived
+static std::vector<uint32_t> latencies;  // encoder to pixel, us
+static std::vector<uint32_t> notelate;  // how late note events went out vs their deadlines, us
+static std::mutex midimutex;
+static uint32_t midicount[NUM_PORTS];
+static std::atomic<int> midiclockbpm{0};
+static std::atomic<uint32_t> softthru;  // input the MIDI library echoed back out
+
+static void writepbm(const char *name, const uint8_t *buf, int16_t w, int16_t h) {
+  FILE *f=fopen(name,"wb");
+  if (!f) return;
+  fprintf(f,"P4\n%d %d\n",w,h);
+  for (int16_t y=0; y<h;++y) {
+    for (int16_t x=0; x<w; x+=8) {
+      uint8_t out=0;
+      for (int16_t b=0; b<8;++b) { // PBM 1 is black - lit OLED pixels come out white
+        bool lit=((x+b) < w) && (buf[x+b+(y/8)*w] & (1 << (y & 7)));
+        if (!lit) out|=0x80 >> b;
+      }
+      fputc(out,f);
+    }
+  }
+  fclose(f);
+}
+
+void simframe(const uint8_t *buf, int16_t w, int16_t h) {
+  uint32_t now=micros();
+  size_t size=w*((h+7)/8);
+  std::lock_guard<std::mutex> lock(framemutex);
+  ++frames;
+  if ((lastframe.size() == size) && (memcmp(lastframe.data(),buf,size) == 0)) return;
+  lastframe.assign(buf,buf+size);
+  ++changedframes;
+  if (inputpending.exchange(false)) latencies.push_back(now-input_us);
+  if (framedir) {
+    char name[256];
+    snprintf(name,sizeof(name),"%s/%010u.pbm",framedir,now);
+    writepbm(name,buf,w,h);
+  }
+}
+
+void simmidiout(const char *port, const uint8_t *msg, uint16_t len) {
+  uint32_t now=micros();
+  std::lock_guard<std::mutex> lock(midimutex);
+  ++midicount[(strcmp(port,"MidiUSB") == 0) ? PORT_USB : PORT_SERIAL];
+  if (midilog) {
+    fprintf(midilog,"%u %s",now,port);
+    for (uint16_t i=0; i<len;++i) fprintf(midilog," %02X",msg[i]);
+    fprintf(midilog,"\n");
+  }
+  if (sysexout && (msg[0] == midi::SystemExclusive)) fwrite(msg,1,len,sysexout);
+}
+
+void simsoftthru(const char *port) {
+  (void)port;
+  ++softthru;
+}
+
+static void siminput(void) {
+  if (!inputpending) {
+    input_us=micros();
+    inputpending=true;
+  }
+}
+
+static void button(uint8_t pin, bool held) {
+  simpin(pin,held ? LOW : HIGH);  // buttons pull to ground
+}
+
+// send each message in a .syx file to the USB port. waits while core 1 works thru them like a host that paces a
+// restore, so the MIDI library's input buffer never overflows
+static void sendsysex(const char *name) {
+  FILE *f=fopen(name,"rb");
+  if (!f) {
+    fprintf(stderr,"sim: can't open %s\n",name);
+    return;
+  }
+  std::vector<uint8_t> msg;
+  int ch;
+  while ((ch=fgetc(f)) != EOF) {
+    if (ch == midi::SystemExclusive) msg.clear();
+    msg.push_back(ch);
+    if (ch != midi::SystemExclusiveEnd) continue;
+    siminjectsysex("MidiUSB",msg.data(),msg.size());
+    delay(1);
+  }
+  fclose(f);
+}
+
+// apply one script command. returns false at the end of the session
+// text is the first argument as written for the commands that take a name
+static bool command(const char *cmd, long a, long b, long c, int nargs, const char *text) {
+  if (!strcmp(cmd,"enc") && (nargs >= 2) && (a >= 0) && (a < NENC)) {enc[a].simturn(b); siminput();}
+  else if (!strcmp(cmd,"click") && (nargs >= 1) && (a >= 0) && (a < NENC)) {enc[a].simbutton(ClickEncoder::Clicked); siminput();}
+  else if (!strcmp(cmd,"dclick") && (nargs >= 1) && (a >= 0) && (a < NENC)) {enc[a].simbutton(ClickEncoder::DoubleClicked); siminput();}
+  else if (!strcmp(cmd,"menu") && (nargs >= 1)) {menuenc.simturn(a); siminput();}
+  else if (!strcmp(cmd,"menuclick")) {menuenc.simbutton(ClickEncoder::Clicked); siminput();}
+  else if (!strcmp(cmd,"shift") && (nargs >= 1)) button(SHIFT_BUTTON,a);
+  else if (!strcmp(cmd,"start") && (nargs >= 1)) button(START_STOP_BUTTON,a);
+  else if (!strcmp(cmd,"track") && (nargs >= 1)) button(MENU_ENCSW_IN,a);
+  else if (!strcmp(cmd,"pin") && (nargs >= 2)) simpin(a,b);
+  else if (!strcmp(cmd,"usb") && (nargs >= 1)) simusbmounted=a;
+  else if (!strcmp(cmd,"midi") && (nargs >= 1)) siminject("MidiUSB",a,b,c);
+  else if (!strcmp(cmd,"din") && (nargs >= 1)) siminject("MidiSerial",a,b,c);
+  else if (!strcmp(cmd,"sysex") && (nargs >= 1)) sendsysex(text);
+  else if (!strcmp(cmd,"midiclock") && (nargs >= 1)) midiclockbpm=a;
+  else if (!strcmp(cmd,"end")) return false;
+  else fprintf(stderr,"sim: bad command %s\n",cmd);
+  return true;
+}
+
+// play a script in real time. returns when the script ends or the run is stopped
+static void playscript(const char *name) {
+  FILE *f=fopen(name,"r");
+  if (!f) {
+    fprintf(stderr,"sim: can't open %s\n",name);
+    return;
+  }
+  char line[256];
+  while (!simquit && fgets(line,sizeof(line),f)) {
+    char *hash=strchr(line,'#');
+    if (hash) *hash=0;
+    char cmd[32];
+    long ms,a=0,b=0,c=0;
+    char sa[32],sb[32],sc[32];
+    int n=sscanf(line,"%ld %31s %31s %31s %31s",&ms,cmd,sa,sb,sc);
+    if (n < 2) continue;
+    if (n > 2) a=strtol(sa,nullptr,0);  // base 0 so MIDI bytes can be written in hex
+    if (n > 3) b=strtol(sb,nullptr,0);
+    if (n > 4) c=strtol(sc,nullptr,0);
+    while (!simquit && ((long)millis() < ms)) delay(1);
+    if (!command(cmd,a,b,c,n-2,sa)) break;
+  }
+  fclose(f);
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, uint8_t pc) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(),v.end());
+  return v[(v.size()-1)*pc/100];
+}
+
+static uint32_t average(const std::vector<uint32_t> &v) {
+  if (v.empty()) return 0;
+  uint64_t sum=0;
+  for (uint32_t x : v) sum+=x;
+  return sum/v.size();
+}
+
+int main(int argc, char **argv) {
+  const char *script=nullptr;
+  float seconds=5;
+  long maxlate=-1,maxlatency=-1;
+  for (int i=1; i<argc-1; i+=2) {
+    if (!strcmp(argv[i],"-s")) script=argv[i+1];
+    else if (!strcmp(argv[i],"-t")) seconds=atof(argv[i+1]);
+    else if (!strcmp(argv[i],"-f")) framedir=argv[i+1];
+    else if (!strcmp(argv[i],"-m")) midilog=fopen(argv[i+1],"w");
+    else if (!strcmp(argv[i],"-x")) sysexout=fopen(argv[i+1],"wb");
+    else if (!strcmp(argv[i],"-j")) maxlate=atol(argv[i+1]);
+    else if (!strcmp(argv[i],"-l")) maxlatency=atol(argv[i+1]);
+    else {
+      fprintf(stderr,"usage: %s [-s script] [-t seconds] [-f framedir] [-m midilog] [-x sysexout] [-j max_late_us] [-l max_latency_us]\n",argv[0]);
+      return 2;
+    }
+  }
+
+  simthread(std::thread([] { // core 0 - UI
+    simcore=0;
+    setup();
+    while (!simquit) loop();
+  }));
+  simthread(std::thread([] { // core 1 - clocks and MIDI
+    simcore=1;
+    setup1();
+    while (!simquit) {
+      simcore1begin();
+      uint32_t sent=emitcount;
+      loop1();
+      if (emitcount != sent) notelate.push_back(emitlate_us); // the last one sent is enough to see the spread
+      simcore1end();
+    }
+  }));
+  simthread(std::thread([] { // external MIDI clock when the script asks for it
+    uint32_t next=micros();
+    while (!simquit) {
+      int bpm=midiclockbpm;
+      if (bpm > 0) {
+        if ((int32_t)(micros()-next) >= 0) {
+          siminject("MidiUSB",midi::Clock,0,0);
+          next+=60000000/(bpm*MIDI_PPQN);
+        }
+      }
+      else next=micros();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }));
+
+  if (script) playscript(script);
+  else delay(seconds*1000);
+  delay(100);  // let the last input reach the screen
+  simquit=true;
+  simjoin();
+
+  fprintf(stderr,"sim: %d tracks, ran %.1f s\n",NTRACKS,millis()/1000.0);
+  fprintf(stderr,"sim: note events %u late avg %u p99 %u max %u us, tick cost max %u us\n",emitcount,
+    average(notelate),percentile(notelate,99),emitlate_max_us,ticktime_max_us);
+  fprintf(stderr,"sim: frames %u changed %u, input to pixel n %zu avg %u p99 %u max %u us\n",frames,changedframes,
+    latencies.size(),average(latencies),percentile(latencies,99),percentile(latencies,100));
+  fprintf(stderr,"sim: MIDI out USB %u DIN %u messages\n",midicount[PORT_USB],midicount[PORT_SERIAL]);
+  fprintf(stderr,"sim: thru to USB n %u max %u us, to DIN n %u max %u us\n",thrustats[PORT_USB].count,thrustats[PORT_USB].max_us,
+    thrustats[PORT_SERIAL].count,thrustats[PORT_SERIAL].max_us);
+  fprintf(stderr,"sim: SysEx dumps sent %u, restores %u, restore errors %u\n",dumpssent,restoresdone,sysexerrors);
+  fprintf(stderr,"sim: MIDI library soft thru echoed %u messages\n",softthru.load());
+  if (midilog) fclose(midilog);
+  if (sysexout) fclose(sysexout);
+
+  int result=0;
+  if ((maxlate >= 0) && (emitlate_max_us > (uint32_t)maxlate)) {
+    fprintf(stderr,"sim: FAIL note lateness over %ld us\n",maxlate);
+    result=1;
+  }
+  if ((maxlatency >= 0) && (percentile(latencies,100) > (uint32_t)maxlatency)) {
+    fprintf(stderr,"sim: FAIL input to pixel latency over %ld us\n",maxlatency);
+    result=1;
+  }
+  if (softthru) { // thru is midithru.h's job - an echo from the library doubles every note played in
+    fprintf(stderr,"sim: FAIL MIDI library soft thru is on\n");
+    result=1;
+  }
+  return result;
+}
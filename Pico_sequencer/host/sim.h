@@ -0,0 +1,24 @@
+// hooks between the Arduino stand-ins in hal.cpp and the simulator in sim.cpp
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+extern std::atomic<bool> simquit;  // set when the run is over - all sim threads stop
+extern std::atomic<bool> simusbmounted;  // what TinyUSBDevice.mounted() returns
+extern thread_local uint8_t simcore;  // which RP2040 core the calling thread stands in for
+
+// implemented by sim.cpp
+void simframe(const uint8_t *buf, int16_t w, int16_t h);  // the sketch called display.display()
+void simmidiout(const char *port, const uint8_t *msg, uint16_t len);  // the sketch sent a MIDI message
+void simsoftthru(const char *port);  // the MIDI library echoed an input message - the sketch turns that off
+
+// implemented by hal.cpp
+void simpin(uint8_t pin, uint8_t level);  // drive a virtual GPIO input
+bool siminject(const char *port, uint8_t status, uint8_t data1, uint8_t data2);  // queue MIDI input for a port's read()
+bool siminjectsysex(const char *port, const uint8_t *msg, uint16_t len);  // and a SysEx message, F0 to F7
+void simcore1begin(void);  // core 1 thread calls these around each loop1() so core 0 can idle it in between
+void simcore1end(void);
+void simthread(std::thread &&t);  // keep a thread to be joined by simjoin()
+void simjoin(void);
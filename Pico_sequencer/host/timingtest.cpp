@@ -0,0 +1,99 @@
+// checks that per-step timing offsets, swing and output delays come out where they were asked for
+// the engine runs like loop1() on the device - a pass every PASS_US of simulated time sends whatever is due and
+// lets do_clocks() render the next tick when it is close enough. every note on is compared with a time worked
+// out here from the grid and the settings, and has to be within MAX_ERROR_US of it
+//   track 1 plain 16ths - the grid everything else is measured from
+//   track 2 a different timing offset on every step, -7 to +8 sixteenths of a step
+//   track 3 swing and a late output delay
+//   track 4 early steps and an early output delay so steps are rendered ahead of their tick
+//
+// build from the Pico_sequencer directory:
+//   g++ -std=gnu++17 -O2 -pthread -Ihost host/timingtest.cpp -o timingtest
+// run:
+//   ./timingtest      exits with 1 if any check fails
+
+#define TESTNAME "timingtest"
+
+#include "batch.h"
+#include "check.h"
+
+#include <math.h>
+
+#define TEST_BPM 133  // a clock period that isn't a round number of us
+#define TEST_BARS 8
+#define STEPS_PER_BAR 16
+#define PASS_US 20  // a loop1() pass
+#define MAX_ERROR_US 50
+#define SWING 33  // %
+#define LATE_DELAY 123  // 12.3 ms
+#define EARLY_DELAY -250  // 25 ms early
+
+// no two neighbours are a whole step apart so every step gets its own note
+static const int8_t timingvals[SEQ_STEPS]={0,3,-3,6,-6,2,-2,5,-5,1,-1,7,-7,4,-4,8};
+
+static std::vector<uint32_t> noteons[NTRACKS];
+
+static void tap(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2) {
+  (void)data1;
+  if ((port != PORT_USB) || ((status & 0xF0) != midi::NoteOn) || (data2 == 0)) return;
+  noteons[status & 0x0F].push_back(rendertime);  // MIDI channel n+1 is track n
+}
+
+static void setup(void) {
+  bpm=TEST_BPM;
+  trackenabled=(1 << NTRACKS)-1;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    gates[track].divider=2;  // 16ths
+    timing[track].divider=2;
+  }
+  for (uint8_t step=0; step<SEQ_STEPS;++step) {
+    timing[1].val[step]=timingvals[step];
+    timing[3].val[step]=(step & 1) ? -4 : 0;
+  }
+  swing[2]=SWING;
+  outputdelay[2]=LATE_DELAY;
+  outputdelay[3]=EARLY_DELAY;
+  setrenderlead();  // what the DLAY menu does
+}
+
+// when step n of a track should be heard, relative to step 0 of track 1
+static double expected(uint8_t track, uint32_t n, double steplen) {
+  double t=n*steplen+timing[track].val[n % SEQ_STEPS]*steplen/(2*TIMINGRANGE);
+  if (n & 1) t+=steplen*swing[track]/100;
+  return t+outputdelay[track]*OUTPUTDELAY_US;
+}
+
+int main(void) {
+  rendersummary summary={};
+  rendering=&summary;
+  porttap=tap;
+  setup();
+  sync_sequencers();
+
+  double steplen=(double)divtable[2]*clockperiod_us();
+  uint32_t steps=TEST_BARS*STEPS_PER_BAR;
+  uint32_t end=(uint32_t)((steps+1)*steplen)+renderlead_us+clockperiod_us();
+  for (rendertime=0; (int32_t)(rendertime-end) < 0; rendertime+=PASS_US) { // one loop1() pass
+    dispatchevents(micros());
+    do_clocks();
+  }
+
+  // step 0 of track 1 can't be early or late against itself so it sets where the grid is. the first bar is left out
+  // because a track that plays early can't go out before the run started
+  double grid=noteons[0].empty() ? 0 : noteons[0][0];
+  int32_t worst[NTRACKS]={};
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    check(noteons[track].size() >= steps,"track %u missing notes, %zu of %u",track+1,noteons[track].size(),steps);
+    for (uint32_t n=STEPS_PER_BAR; (n < steps) && (n < noteons[track].size());++n) {
+      int32_t error=lround(noteons[track][n]-(grid+expected(track,n,steplen)));
+      if (abs(error) > abs(worst[track])) worst[track]=error;
+      check(abs(error) <= MAX_ERROR_US,"track %u step %u note on %d us from its time",track+1,n,error);
+    }
+  }
+  check(emitlate_max_us <= MAX_ERROR_US,"a note event went out %u us late",emitlate_max_us);
+
+  printf("timingtest: %u BPM %u steps per track, worst error us",TEST_BPM,steps);
+  for (uint8_t track=0; track<NTRACKS;++track) printf(" %d",worst[track]);
+  printf(", latest note event %u us\n",emitlate_max_us);
+  return testresult();
+}
@@ -0,0 +1,93 @@
+// generate random variants of a track's step modes, rates, euclidean rhythm and probability, render them all
+// with the batch renderer and list the ones that fit a target density and pitch range
+//
+// build from the Pico_sequencer directory:
+//   g++ -std=gnu++17 -O2 -pthread -Ihost host/variants.cpp -o variants
+// run:
+//   ./variants [count] [bars] [threads] [seed]    defaults 10000 variants, 8 bars, one thread per CPU, seed 1
+// with threads set to "scale" it renders the batch with 1,2,4.. threads up to the CPU count and shows the speedup
+
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+
+#define TARGET_NOTES_PER_BAR 6
+#define TARGET_RANGE 12  // semitones
+
+struct generator {
+  uint32_t seed;
+};
+
+// small hash so variant n always gets the same settings whatever thread renders it
+uint32_t pick(uint32_t *x, uint32_t n) {
+  *x^=*x << 13;
+  *x^=*x >> 17;
+  *x^=*x << 5;
+  return ((uint64_t)*x*n) >> 32;
+}
+
+// randomise track 1 - note values, step modes and rates of the note, gate and probability lanes, a euclidean rhythm
+void randomtrack(uint32_t variant, void *arg) {
+  uint32_t x=(variant+1)*0x9E3779B9 ^ ((generator *)arg)->seed;
+  if (x == 0) x=1;
+  for (uint8_t step=0; step<SEQ_STEPS;++step) notes[0].val[step]=pick(&x,2*NOTERANGE+1)-NOTERANGE;
+  sequencer *lanes[]={&notes[0],&gates[0],&probability[0]};
+  for (sequencer *seq : lanes) {
+    seq->stepmode=pick(&x,RANDOM+1);
+    seq->divider=2+pick(&x,7);  // 4x to /2
+    seq->last=3+pick(&x,SEQ_STEPS-3);
+  }
+  probability[0].euclen=5+pick(&x,SEQ_STEPS-4);
+  probability[0].eucbeats=1+pick(&x,probability[0].euclen);
+  probability[0].root=pick(&x,probability[0].euclen);
+  applyeuclid(0);
+  seeds[0]=variant;
+}
+
+// closer to the target density and range is better
+int32_t score(const rendersummary *r, uint16_t bars) {
+  int32_t perbar=r->notes*10/bars;
+  int32_t range=r->highest-r->lowest;
+  return -abs(perbar-TARGET_NOTES_PER_BAR*10)-abs(range-TARGET_RANGE)*5+r->distinct*2;
+}
+
+double timebatch(uint32_t count, generator *g, uint32_t ticks, rendersummary *out, unsigned threads) {
+  auto t0=std::chrono::steady_clock::now();
+  renderbatch(count,randomtrack,g,ticks,out,threads);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+int main(int argc, char **argv) {
+  uint32_t count=(argc > 1) ? atol(argv[1]) : 10000;
+  uint16_t bars=(argc > 2) ? atoi(argv[2]) : 8;
+  bool scaling=(argc > 3) && !strcmp(argv[3],"scale");
+  unsigned threads=((argc > 3) && !scaling) ? atoi(argv[3]) : 0;
+  generator g={(argc > 4) ? (uint32_t)atol(argv[4]) : 1};
+  uint32_t ticks=bars*4*PPQN;
+  std::vector<rendersummary> out(count);
+
+  if (scaling) {
+    unsigned cpus=std::max(1u,std::thread::hardware_concurrency());
+    double t1=0;
+    for (unsigned n=1; n<=cpus; n=(n*2 > cpus && n < cpus) ? cpus : n*2) {
+      double t=timebatch(count,&g,ticks,out.data(),n);
+      if (n == 1) t1=t;
+      printf("%2u threads %7.3f s %8.0f variants/s speedup %.2f\n",n,t,count/t,t1/t);
+    }
+    return 0;
+  }
+
+  double t=timebatch(count,&g,ticks,out.data(),threads);
+  printf("%u variants of %u bars in %.3f s - %.0f variants/s\n",count,bars,t,count/t);
+
+  std::vector<uint32_t> order(count);
+  for (uint32_t i=0; i<count;++i) order[i]=i;
+  std::sort(order.begin(),order.end(),[&](uint32_t a, uint32_t b) {return score(&out[a],bars) > score(&out[b],bars);});
+  printf("variant  notes/bar range distinct poly vel  hash\n");
+  for (uint32_t i=0; i<std::min(count,10u);++i) {
+    const rendersummary *r=&out[order[i]];
+    printf("%7u %9.1f %5u %8u %4u %3u  %08x\n",order[i],(float)r->notes/bars,r->highest-r->lowest,r->distinct,r->maxpoly,r->velocity_avg,r->hash);
+  }
+  return 0;
+}
@@ -49,9 +49,14 @@ const uint8_t submenu_X[]= {0,32,64,96,0,32,64,96};  // X location of the submen
 const uint8_t submenu_Y[]= {SUBMENU_Y0,SUBMENU_Y0,SUBMENU_Y0,SUBMENU_Y0,SUBMENU_Y1,SUBMENU_Y1,SUBMENU_Y1,SUBMENU_Y1};  // y location of the submenu titles by pixel
 const uint8_t submenu_value_Y[]= {SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y1,SUBMENU_VALUE_Y1,SUBMENU_VALUE_Y1,SUBMENU_VALUE_Y1};  // y location of the submenu values by pixel
 
-enum paramtype{TYPE_NONE,TYPE_INTEGER,TYPE_FLOAT, TYPE_TEXT}; // parameter display types
+// TYPE_ACTION is a command rather than a value - it shows its text and turning the encoder either way runs the handler
+enum paramtype{TYPE_NONE,TYPE_INTEGER,TYPE_FLOAT, TYPE_TEXT, TYPE_TENTHS, TYPE_ACTION}; // parameter display types
+// how the parameter is stored - every table entry names its binding so a wrong one is easy to spot
+// BIND_BIT parameters are one bit of a uint16_t ie flags packed one bit per track. BIND_NONE is for actions
+enum bindtype{BIND_INT16,BIND_INT8,BIND_UINT8,BIND_BIT,BIND_NONE};
 
 // submenus 
+// the menu values are always handled as int16 but the parameter can be stored in a smaller type to save RAM
 struct submenu {
   const char *name; // display short name
   const char *longname; // longer name displays on message line
@@ -59,16 +64,18 @@ struct submenu {
   int16_t max;  // max value of parameter
   int16_t step; // step size. if 0, don't print ie spacer
   enum paramtype ptype; // how its displayed
-  const char ** ptext;   // points to array of text for text display
-  int16_t *parameter; // value to modify
+  const char * const * ptext;   // points to array of text for text display
+  void *parameter; // value to modify - type given by binding
   void (*handler)(void);  // function to call on value change
+  enum bindtype binding; // storage type of the parameter
+  uint8_t bit;  // bit number for BIND_BIT parameters
+  void (*setter)(int16_t); // optional - called to store the value instead of writing to the parameter directly
 };
 
 // top menus
 struct menu {
    const char *name; // menu text
-   struct submenu * submenus; // points to submenus for this menu
-   int8_t submenuindex;   // stores the index of the submenu we are currently using
+   const struct submenu * submenus; // points to submenus for this menu
    int8_t numsubmenus; // number of submenus - not sure why this has to be int but it crashes otherwise. compiler bug?
 };
 
@@ -77,221 +84,112 @@ struct menu {
 long messagetimer;
 bool message_displayed;
 
-int16_t enab1 =1;
-int16_t enab2 =2;
-int16_t level1,pan1;
+void startdump(void); // DUMP menu action - in sysex.h which comes after the menus
 
 int16_t nul;    // dummy parameter and function for testing
 void dummy( void) {}
 
+// menu function handler for the random seed - restart the current track's generator from the new seed
+void reseed(void) {
+  rp2040.idleOtherCore();
+  rngseed(current_track,seeds[current_track]);
+  rp2040.resumeOtherCore();
+}
+
 // ********** menu structs that build the menu system below *********
 
 // text arrays used for submenu TYPE_TEXT fields
-const char * textoffon[] = {" OFF", "  ON"};
-const char * textstepmode[] = {" FWD", " REV","PONG","WALK","RAND"};
+// pointers are const too so the tables stay in flash instead of being copied to RAM at startup
+const char * const textoffon[] = {" OFF", "  ON"};
+const char * const textrecord[] = {" OFF","LIVE","STEP"}; // see RECORDMODES
+const char * const textthru[] = {" OFF"," USB"," DIN","BOTH"}; // see THRUDESTS
+const char * const textsend[] = {"SEND"};
+const char * const textfills[] = {" OFF"," ALL"," ODD","EVEN"}; // see fillpatterns[]
+const char * const textstepmode[] = {" FWD", " REV","PONG","WALK","RAND"};
 //{CHROMATIC,MAJOR,MINOR,HARMONIC_MINOR,MAJOR_PENTATONIC,MINOR_PENTATONIC,DORIAN,PHRYGIAN,LYDIAN,MIXOLYDIAN};
-const char * scalenames[] = {"Chro","Maj", "Min","Hmin","MPen","mPen","Dor","Phry","Lyd","Mixo"};
-const char * textrates[] = {" 8x"," 6x"," 4x"," 3x", " 2x","1.5x"," 1x","/1.5"," /2"," /3"," /4"," /5"," /6"," /7"," /8"," /9"," /10"," /11"," /12"," /13"," /14"," /15"," /16"," /32"," /64","/128"};
+const char * const scalenames[] = {"Chro","Maj", "Min","Hmin","MPen","mPen","Dor","Phry","Lyd","Mixo"};
+const char * const textrates[] = {" 8x"," 6x"," 4x"," 3x", " 2x","1.5x"," 1x","/1.5"," /2"," /3"," /4"," /5"," /6"," /7"," /8"," /9"," /10"," /11"," /12"," /13"," /14"," /15"," /16"," /32"," /64","/128"};
 
 // NOTE that the order and number of the text menus much match the graphical UI pages
 // ie we keep the graphic display and its associated text menus in sync - uses variable UIpage for main menus - notes, gates etc
 // current_track is the index of the sequence we are editing which indexes into the submenus ie note 1, note 2
-// menus are created at compile time so we have to point to each sequencer array parameter individually
-struct submenu note1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[0].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[0].root,0,
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[0],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[0],0,
-  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[0],0,
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-
-struct submenu note2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[1].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[1].root,0,
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[1],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[1],0,
-  "ENAB","Enable Seq",0,1,1,TYPE_TEXT,textoffon,&trackenabled[1],0,
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-struct submenu note3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[2].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[2].root,0, 
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[2],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[2],0,
-  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[2],0, 
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-struct submenu note4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[3].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[3].root,0,
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[3],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[3],0,
-  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[3],0,
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-
-struct submenu gate1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[0].stepmode,0,
-};
-struct submenu gate2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[1].stepmode,0,
-};
-struct submenu gate3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[2].stepmode,0,
-};
-struct submenu gate4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[3].stepmode,0,
-};
-
-struct submenu velocity1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[0].stepmode,0,
-};
-struct submenu velocity2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[1].stepmode,0,
-};
-struct submenu velocity3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[2].stepmode,0,
-};
-struct submenu velocity4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[3].stepmode,0,
-};
-
-struct submenu offset1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[0].stepmode,0,
-};
-struct submenu offset2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[1].stepmode,0,
-};
-struct submenu offset3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[2].stepmode,0,
-};
-struct submenu offset4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[3].stepmode,0,
-};
-
-struct submenu probability1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[0].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[0].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[0].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[0].root,eucprobability,
-};
-struct submenu probability2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[1].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[1].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[1].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[1].root,eucprobability,
-};
-struct submenu probability3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[2].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[2].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[2].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[2].root,eucprobability,
-};
-struct submenu probability4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[3].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[3].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[3].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[3].root,eucprobability,
-};
-
-struct submenu ratchet1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[0].stepmode,0,
-};
-struct submenu ratchet2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[1].stepmode,0,
-};
-struct submenu ratchet3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[2].stepmode,0,
-};
-struct submenu ratchet4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[3].stepmode,0,
-};
-
-struct submenu mod1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[0].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[0],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[0].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[0],0,
-};
-struct submenu mod2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[1].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[1],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[1].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[1],0,
-};
-struct submenu mod3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[2].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[2],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[3].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[2],0,
-};
-struct submenu mod4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[3].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[3],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[3].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[3],0,
-};
+// menus point to each sequencer array parameter individually so they are generated per track at compile time - see tracks.h
+// name,longname,min,max,step,type,*textfield,*parameter,*handler,binding,bit,*setter
+#define NOTE_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[track].stepmode,0,BIND_INT8,0,0}, \
+  {"ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[track].root,0,BIND_INT8,0,0}, \
+  {"SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[track],0,BIND_UINT8,0,0}, \
+  {"CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[track],0,BIND_UINT8,0,0}, \
+  {"ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled,0,BIND_BIT,track,0}, \
+  {" BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,BIND_UINT8,0,0}, \
+  {"MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,BIND_UINT8,0,0}, \
+  {"DLAY","Output Delay ms",-OUTPUTDELAY_MAX,OUTPUTDELAY_MAX,1,TYPE_TENTHS,0,&outputdelay[track],setrenderlead,BIND_INT16,0,0}, \
+  {" REC","Record Notes",0,2,1,TYPE_TEXT,textrecord,&recordmode,startrecord,BIND_UINT8,0,0}, \
+  {"UTHR","USB In Thru To",0,3,1,TYPE_TEXT,textthru,&thrudest[PORT_USB],setthru,BIND_UINT8,0,0}, \
+  {" UCH","USB Thru Ch 0=All",0,16,1,TYPE_INTEGER,0,&thruchannel[PORT_USB],setthru,BIND_UINT8,0,0}, \
+  {"DTHR","DIN In Thru To",0,3,1,TYPE_TEXT,textthru,&thrudest[PORT_SERIAL],setthru,BIND_UINT8,0,0}, \
+  {" DCH","DIN Thru Ch 0=All",0,16,1,TYPE_INTEGER,0,&thruchannel[PORT_SERIAL],setthru,BIND_UINT8,0,0}, \
+  {"TRNS","Transpose Ch 0=Off",0,16,1,TYPE_INTEGER,0,&transposechan[track],settranspose,BIND_UINT8,0,0}, \
+  {"DUMP","Send Dump Over USB",0,0,1,TYPE_ACTION,textsend,0,startdump,BIND_NONE,0,0}, \
+},
+
+#define GATE_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[track].stepmode,0,BIND_INT8,0,0}, \
+  {"FILL","Fill Steps",0,3,1,TYPE_TEXT,textfills,&fillmode[track],setfill,BIND_UINT8,0,0}, \
+},
+
+#define VELOCITY_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[track].stepmode,0,BIND_INT8,0,0}, \
+},
+
+#define OFFSET_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[track].stepmode,0,BIND_INT8,0,0}, \
+},
+
+#define PROBABILITY_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[track].stepmode,0,BIND_INT8,0,0}, \
+  {" LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[track].euclen,eucprobability,BIND_INT8,0,0}, \
+  {"BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[track].eucbeats,eucprobability,BIND_INT8,0,0}, \
+  {"OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[track].root,eucprobability,BIND_INT8,0,0}, \
+  {"SEED","Random Seed",0,9999,1,TYPE_INTEGER,0,&seeds[track],reseed,BIND_INT16,0,0}, \
+},
+
+#define RATCHET_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[track].stepmode,0,BIND_INT8,0,0}, \
+  {"GATE","Ratchet Gate %",5,100,5,TYPE_INTEGER,0,&ratchetgate[track],0,BIND_UINT8,0,0}, \
+  {"VRMP","Velocity Ramp %",-100,100,5,TYPE_INTEGER,0,&ratchetramp[track],0,BIND_INT8,0,0}, \
+},
+
+#define MOD_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[track].stepmode,0,BIND_INT8,0,0}, \
+  {"CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[track],0,BIND_UINT8,0,0}, \
+  {"  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[track].root,0,BIND_INT8,0,0}, \
+  {"ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled,0,BIND_BIT,track,0}, \
+  {"RAMP","Smooth CC Ramps",0,1,1,TYPE_TEXT,textoffon,&mod_ramp,0,BIND_BIT,track,0}, \
+},
+
+#define TIMING_PARAMS(track,number) { \
+  {"RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&timing[track].divider,0,BIND_INT8,0,0}, \
+  {"MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&timing[track].stepmode,0,BIND_INT8,0,0}, \
+  {"SWNG","Swing % of Step",0,SWINGRANGE,1,TYPE_INTEGER,0,&swing[track],0,BIND_UINT8,0,0}, \
+},
+
+// one row of submenus per track. const so they stay in flash
+const struct submenu noteparams[NTRACKS][16] = { FOR_EACH_TRACK(NOTE_PARAMS) };
+const struct submenu gateparams[NTRACKS][3] = { FOR_EACH_TRACK(GATE_PARAMS) };
+const struct submenu velocityparams[NTRACKS][2] = { FOR_EACH_TRACK(VELOCITY_PARAMS) };
+const struct submenu offsetparams[NTRACKS][2] = { FOR_EACH_TRACK(OFFSET_PARAMS) };
+const struct submenu probabilityparams[NTRACKS][6] = { FOR_EACH_TRACK(PROBABILITY_PARAMS) };
+const struct submenu ratchetparams[NTRACKS][4] = { FOR_EACH_TRACK(RATCHET_PARAMS) };
+const struct submenu modparams[NTRACKS][6] = { FOR_EACH_TRACK(MOD_PARAMS) };
+const struct submenu timingparams[NTRACKS][3] = { FOR_EACH_TRACK(TIMING_PARAMS) };
 
 /*
 
@@ -307,51 +205,86 @@ struct submenu env0params[] = {
 */
 
 // top level menu structure - each top level menu contains one submenu
-struct menu mainmenu[] = {
-  // name,submenu *,initial submenu index,number of submenus
-  "Note 1",note1params,0,sizeof(note1params)/sizeof(submenu),
-  "Note 2",note2params,0,sizeof(note2params)/sizeof(submenu),
-  "Note 3",note3params,0,sizeof(note3params)/sizeof(submenu),
-  "Note 4",note4params,0,sizeof(note4params)/sizeof(submenu),
-  "Gate 1",gate1params,0,sizeof(gate1params)/sizeof(submenu),
-  "Gate 2",gate2params,0,sizeof(gate2params)/sizeof(submenu),
-  "Gate 3",gate3params,0,sizeof(gate3params)/sizeof(submenu),
-  "Gate 4",gate4params,0,sizeof(gate4params)/sizeof(submenu),
-  "Velocity 1",velocity1params,0,sizeof(velocity1params)/sizeof(submenu),
-  "Velocity 2",velocity2params,0,sizeof(velocity2params)/sizeof(submenu),
-  "Velocity 3",velocity3params,0,sizeof(velocity3params)/sizeof(submenu),
-  "Velocity 4",velocity4params,0,sizeof(velocity4params)/sizeof(submenu),
-  "Offset 1",offset1params,0,sizeof(offset1params)/sizeof(submenu),
-  "Offset 2",offset2params,0,sizeof(offset2params)/sizeof(submenu),
-  "Offset 3",offset3params,0,sizeof(offset3params)/sizeof(submenu),
-  "Offset 4",offset4params,0,sizeof(offset4params)/sizeof(submenu),
-  "Probability 1",probability1params,0,sizeof(probability1params)/sizeof(submenu),
-  "Probability 2",probability2params,0,sizeof(probability2params)/sizeof(submenu),
-  "Probability 3",probability3params,0,sizeof(probability3params)/sizeof(submenu),
-  "Probability 4",probability4params,0,sizeof(probability4params)/sizeof(submenu),
-  "Ratchets 1",ratchet1params,0,sizeof(ratchet1params)/sizeof(submenu),
-  "Ratchets 2",ratchet2params,0,sizeof(ratchet2params)/sizeof(submenu),
-  "Ratchets 3",ratchet3params,0,sizeof(ratchet3params)/sizeof(submenu),
-  "Ratchets 4",ratchet4params,0,sizeof(ratchet4params)/sizeof(submenu),
-  "Mods 1",mod1params,0,sizeof(mod1params)/sizeof(submenu),
-  "Mods 2",mod2params,0,sizeof(mod2params)/sizeof(submenu),
-  "Mods 3",mod3params,0,sizeof(mod3params)/sizeof(submenu),
-  "Mods 4",mod4params,0,sizeof(mod4params)/sizeof(submenu),
+// grouped by UI page then track so UIpage*NTRACKS+current_track finds the menu for the page we are on
+// name,submenu *,number of submenus
+#define NUM_SUBMENUS(params) (sizeof(params[0])/sizeof(submenu))
+#define NOTE_MENU(track,number) {"Note " #number,noteparams[track],NUM_SUBMENUS(noteparams)},
+#define GATE_MENU(track,number) {"Gate " #number,gateparams[track],NUM_SUBMENUS(gateparams)},
+#define VELOCITY_MENU(track,number) {"Velocity " #number,velocityparams[track],NUM_SUBMENUS(velocityparams)},
+#define OFFSET_MENU(track,number) {"Offset " #number,offsetparams[track],NUM_SUBMENUS(offsetparams)},
+#define PROBABILITY_MENU(track,number) {"Probability " #number,probabilityparams[track],NUM_SUBMENUS(probabilityparams)},
+#define RATCHET_MENU(track,number) {"Ratchets " #number,ratchetparams[track],NUM_SUBMENUS(ratchetparams)},
+#define MOD_MENU(track,number) {"Mods " #number,modparams[track],NUM_SUBMENUS(modparams)},
+#define TIMING_MENU(track,number) {"Timing " #number,timingparams[track],NUM_SUBMENUS(timingparams)},
+
+const struct menu mainmenu[] = {
+  FOR_EACH_TRACK(NOTE_MENU)
+  FOR_EACH_TRACK(GATE_MENU)
+  FOR_EACH_TRACK(VELOCITY_MENU)
+  FOR_EACH_TRACK(OFFSET_MENU)
+  FOR_EACH_TRACK(PROBABILITY_MENU)
+  FOR_EACH_TRACK(RATCHET_MENU)
+  FOR_EACH_TRACK(MOD_MENU)
+  FOR_EACH_TRACK(TIMING_MENU)
 };
 
 #define NUM_MAIN_MENUS sizeof(mainmenu)/ sizeof(menu)
-menu * topmenu=mainmenu;  // points at current menu
+const menu * topmenu=mainmenu;  // points at current menu
+int8_t submenuindex[NUM_MAIN_MENUS];  // index of the submenu we are currently using in each top menu - kept in RAM so mainmenu can be in flash
 int16_t topmenuindex=0;  // keeps track of which top menu item we are displaying
 
 // ******* menu handling code ************
 
+// fetch a parameter value from wherever the submenu binds it
+int16_t getparam(const submenu * sub) {
+  switch (sub->binding) {
+    case BIND_INT8:
+      return *(int8_t *)sub->parameter;
+    case BIND_UINT8:
+      return *(uint8_t *)sub->parameter;
+    case BIND_BIT:
+      return bitRead(*(uint16_t *)sub->parameter,sub->bit);
+    case BIND_NONE:
+      return 0;
+    case BIND_INT16:
+    default:
+      return *(int16_t *)sub->parameter;
+  }
+}
+
+// store a parameter value. caller must make sure core 1 is not using it
+void setparam(const submenu * sub, int16_t val) {
+  if (sub->setter != 0) {
+    (*sub->setter)(val);
+    return;
+  }
+  switch (sub->binding) {
+    case BIND_INT8:
+      *(int8_t *)sub->parameter=val;
+      break;
+    case BIND_UINT8:
+      *(uint8_t *)sub->parameter=val;
+      break;
+    case BIND_BIT: {
+      uint16_t bits=*(uint16_t *)sub->parameter;
+      if (val) bitSet(bits,sub->bit);
+      else bitClear(bits,sub->bit);
+      *(uint16_t *)sub->parameter=bits; // single store so core 1 never sees a half updated value
+      break;
+    }
+    case BIND_NONE:  // an action - the handler does the work
+      break;
+    case BIND_INT16:
+    default:
+      *(int16_t *)sub->parameter=val;
+      break;
+  }
+}
+
 // display the top menu
+// callers send the buffer to the display once everything has been drawn
 void drawtopmenu( int8_t index) {
-    display.setCursor ( 0, TOPMENU_Y ); 
-    display.print("                    "); // kludgy line erase
-    display.setCursor ( 0, TOPMENU_Y ); 
-    display.print(topmenu[index].name);
-    display.display();
+    blittoend(blittext(0,TOPMENU_Y,topmenu[index].name),TOPMENU_Y); // erase the rest of the line
 }
 
 // display a sub menu item and its value
@@ -359,55 +292,51 @@ void drawtopmenu( int8_t index) {
 // pos is the relative x location on the screen ie field 0,1,2,3,4,5,6,7
 // for the Pico sequencer 0-3 shown on top, 4-7 shown on the bottom of the display - we have lots of encoders to use for editing
 void drawsubmenu( int8_t index, int8_t pos) {
-    submenu * sub;
+    const submenu * sub;
+    int16_t x;
     // print the name text
-    //display.setCursor ((DISPLAY_X/SUBMENU_FIELDS)*pos*DISPLAY_CHAR_WIDTH+DISPLAY_X_MENUPAD, SUBMENU_Y ); // set cursor to parameter name field - staggered short names
-    display.setCursor (submenu_X[pos], submenu_Y[pos]); // set cursor to parameter name field - staggered long names
     sub=topmenu[topmenuindex].submenus; //get pointer to the submenu array
-    if (index < topmenu[topmenuindex].numsubmenus) display.print(sub[index].name); // make sure we aren't beyond the last parameter in this submenu
-    else display.print("     ");
+    if (index < topmenu[topmenuindex].numsubmenus) blittext(submenu_X[pos], submenu_Y[pos],sub[index].name); // make sure we aren't beyond the last parameter in this submenu
+    else blittext(submenu_X[pos], submenu_Y[pos],"     ");
     
     // print the value
-    display.setCursor (submenu_X[pos], submenu_value_Y[pos]); // set cursor to parameter value field
-    display.print("     "); // erase old value
-    display.setCursor (submenu_X[pos], submenu_value_Y[pos] ); // set cursor to parameter value field
+    blittext(submenu_X[pos], submenu_value_Y[pos],"     "); // erase old value
+    x=submenu_X[pos]; // parameter value field
     if ((sub[index].step !=0) && (index < topmenu[topmenuindex].numsubmenus)) { // don't print dummy parameter or beyond the last submenu item
-      int16_t val=*sub[index].parameter;  // fetch the parameter value   // 
-      //if (val> sub[index].max) *sub[index].parameter=val=sub[index].max; // check the parameter range and limit if its out of range ie we loaded a bad patch
-     // if (val< sub[index].min) *sub[index].parameter=val=sub[index].min; // check the parameter range and limit if its out of range ie we loaded a bad patch
-      char temp[5];
+      int16_t val=getparam(&sub[index]);  // fetch the parameter value   // 
       switch (sub[index].ptype) {
-        case TYPE_INTEGER:   // print the value as an unsigned integer          
-          sprintf(temp,"%4d",val); // lcd.print doesn't seem to print uint8 properly
-          display.print(temp);  
-          display.print(" ");  // blank out any garbage
+        case TYPE_INTEGER:   // print the value as an integer
+          blitf(x,submenu_value_Y[pos],"%4d ",val); // trailing space blanks out any garbage
+          break;
+        case TYPE_FLOAT: { // print the int value as a float - menu should have int value between -9999 +9999 so float is -9.99 to +9.99
+          int16_t hundredths=(abs(val)+5)/10; // rounded like %1.2f
+          blitf(x,submenu_value_Y[pos],"%s%d.%02d ",(val < 0) && hundredths ? "-" : "",hundredths/100,hundredths%100);
           break;
-        case TYPE_FLOAT:   // print the int value as a float 
-          sprintf(temp,"%1.2f",(float)val/1000); // menu should have int value between -9999 +9999 so float is -9.99 to +9.99
-          display.print(temp);  
-          display.print(" ");  // blank out any garbage
+        }
+        case TYPE_TENTHS: // print the int value with one decimal place ie -500 is -50.0
+          blitf(x,submenu_value_Y[pos],"%s%d.%d ",val < 0 ? "-" : "",abs(val)/10,abs(val)%10);
+          break;
+        case TYPE_ACTION:  // always the same text
+          blitf(x,submenu_value_Y[pos],"%s ",sub[index].ptext[0]);
           break;
         case TYPE_TEXT:  // use the value to look up a string
           if (val > sub[index].max) val=sub[index].max; // sanity check
           if (val < 0) val=0; // min index is 0 for text fields
-          display.print(sub[index].ptext[val]); // parameter value indexes into the string array
-          display.print(" ");  // blank out any garbage
+          blitf(x,submenu_value_Y[pos],"%s ",sub[index].ptext[val]); // parameter value indexes into the string array
           break;
         default:
         case TYPE_NONE:  // blank out the field
-          display.print("     ");
           break;
       } 
     }
-
-    display.display(); 
 }
 
 // display the sub menus of the current top menu
 
 void drawsubmenus() {
-  int8_t index = topmenu[topmenuindex].submenuindex;
+  int8_t index = submenuindex[topmenuindex];
   for (int8_t i=0; i< SUBMENU_FIELDS; ++i) drawsubmenu(index++,i);
+  display.display(); // one transfer for the whole page
 }
 
 //adjust the topmenu index and update the menus and submenus
@@ -425,9 +354,9 @@ void scrollmenus(int8_t dir) {
 void scrollsubmenus(int8_t dir) {
   if (dir !=0) { // don't redraw if there is no change
     dir= dir*SUBMENU_FIELDS; // sidescroll SUBMENU_FIELDS at a time
-    topmenu[topmenuindex].submenuindex+= dir;
-    if (topmenu[topmenuindex].submenuindex < 0) topmenu[topmenuindex].submenuindex = 0; // stop at first submenu
-    if (topmenu[topmenuindex].submenuindex >= topmenu[topmenuindex].numsubmenus ) topmenu[topmenuindex].submenuindex -=dir; // stop at last submenu     
+    submenuindex[topmenuindex]+= dir;
+    if (submenuindex[topmenuindex] < 0) submenuindex[topmenuindex] = 0; // stop at first submenu
+    if (submenuindex[topmenuindex] >= topmenu[topmenuindex].numsubmenus ) submenuindex[topmenuindex] -=dir; // stop at last submenu     
     display.clearDisplay();  // for now, redraw everything
     drawtopmenu(topmenuindex);
     drawsubmenus(); 
@@ -436,16 +365,14 @@ void scrollsubmenus(int8_t dir) {
 
 // show a message on 2nd line of display - it gets auto erased after a timeout
 void showmessage(const char * message) {
-  display.setCursor(0, MSG_Y); 
-  display.print(message);
+  blittext(0,MSG_Y,message);
   messagetimer=millis();
   message_displayed=true;
 }
 
 // clear the message on the message line
 void erasemessage(void) {
-    display.setCursor(0, MSG_Y); 
-    display.print("                    "); 
+    blittoend(0,MSG_Y); 
     message_displayed=false; 
 }
 
@@ -456,14 +383,12 @@ void domenus(void) {
   ClickEncoder::Button button; 
   // process the menu encoder - scroll submenus, scroll main menu when button down
   encoder=menuenc.getValue(); // compiler bug - can't do this inside the if statement
-/*
-  if ( enc != 0) {  // if encoder is rotated, side scroll to more menu parameters if there are any
+  if (encoder != 0) {  // if encoder is rotated, side scroll to more menu parameters if there are any
       scrollsubmenus(encoder);           
   }
-*/
 
-  index= topmenu[topmenuindex].submenuindex; // submenu field index
-  submenu * sub=topmenu[topmenuindex].submenus; //get pointer to the current submenu array
+  index= submenuindex[topmenuindex]; // submenu field index
+  const submenu * sub=topmenu[topmenuindex].submenus; //get pointer to the current submenu array
  
   
  // process parameter encoders
@@ -478,16 +403,17 @@ void domenus(void) {
 
   for (int field=0; field<SUBMENU_FIELDS;++field) { // loop thru the on screen submenus
     if (encodervalue[field]!=0) {  // if there is some input, process it
-      int16_t temp=*sub[index].parameter + encodervalue[field]*sub[index].step; // menu code uses ints - convert to floats when needed
+      int16_t temp=getparam(&sub[index]) + encodervalue[field]*sub[index].step; // menu code uses ints - convert to floats when needed
       if (temp < (int16_t)sub[index].min) temp=sub[index].min;
       if (temp > (int16_t)sub[index].max) temp=sub[index].max;
       rp2040.idleOtherCore();  // stop core 1 while we change the value
-      *sub[index].parameter=temp;
+      setparam(&sub[index],temp);
       rp2040.resumeOtherCore();
       if (sub[index].handler != 0) (*sub[index].handler)();  // call the handler function
       erasemessage(); // undraw old longname
       showmessage(sub[index].longname);  // show the long name of what we are editing
       drawsubmenu(index,field);
+      display.display();
       //Serial.printf("index %d field %d\n",index,field);
     }
     ++index;
@@ -0,0 +1,171 @@
+// MIDI output ports, bandwidth accounting and output scheduling
+// the DIN port is 31250 baud which is only ~1000 3 byte messages per second so anything optional like CC ramps
+// has to fit in whatever the notes leave over. USB is much faster but not unlimited
+// nothing in here uses the Arduino API so the budget maths can be checked on a PC
+
+enum MIDIPORTS {PORT_USB,PORT_SERIAL,NUM_PORTS};
+
+#define SERIAL_MIDI_BYTES_PER_SEC 3125   // 31250 baud, 10 bits per byte
+#define USB_MIDI_BYTES_PER_SEC 48000     // conservative - full speed USB MIDI does ~16 packets per ms but hosts vary
+#define MIDI_MSG_BYTES 3                 // note on/off and CC are all 3 bytes. we don't count on running status
+#define PORT_HEADROOM_PERCENT 75         // only plan to use this much of a port so it is drained before the next tick
+
+const uint32_t port_bytes_per_sec[NUM_PORTS] = {USB_MIDI_BYTES_PER_SEC,SERIAL_MIDI_BYTES_PER_SEC};
+
+SEQ_STATE uint16_t tickbytes[NUM_PORTS]; // bytes sent or rendered for each port since the start of the current clock tick
+
+// bytes a port can move in one clock tick, less headroom
+uint32_t port_bytes_per_tick(uint32_t bytes_per_sec, uint32_t tickperiod_us) {
+  return (uint32_t)(((uint64_t)bytes_per_sec*tickperiod_us*PORT_HEADROOM_PERCENT)/(100*1000000ULL));
+}
+
+// number of optional messages (ie CC ramp points) that still fit on a port this tick
+// used is what has already gone out - notes and step CCs are sent first and always sent
+int16_t msgbudget(uint32_t bytes_per_sec, uint32_t tickperiod_us, uint16_t used) {
+  uint32_t avail=port_bytes_per_tick(bytes_per_sec,tickperiod_us);
+  if (used >= avail) return 0;
+  return (avail-used)/MIDI_MSG_BYTES;
+}
+
+// start a new tick's accounting
+void clearportbytes(void) {
+  for (uint8_t port=0; port<NUM_PORTS;++port) tickbytes[port]=0;
+}
+
+// ------------- output scheduler -------------
+// messages are queued per port in priority classes and written out by flushmidi() on core 1
+// realtime (clock) goes first, then notes, then CCs. CCs are held back while the port is still busy
+// with earlier bytes so a burst of CCs can't push the next note back by several ms on the DIN port
+// a CC that is still waiting when a newer value for the same controller arrives is simply updated
+
+enum MIDICLASSES {CLASS_REALTIME,CLASS_NOTE,CLASS_CC,NUM_CLASSES}; // output priority, highest first
+
+#define MIDIQ_SIZE 64  // messages per port per class - must be a power of 2
+#define CC_MAX_BACKLOG_US 1000 // hold CCs while the port has more than this much queued - about 1 message on DIN
+
+struct midimsg {
+  uint8_t status;  // status byte including channel ie 0x90 is note on channel 1
+  uint8_t data1;
+  uint8_t data2;
+  bool thru;  // came in on an input port - see midithru(). fits in the byte before queued_us
+  uint32_t queued_us;  // when it was queued - for latency stats
+};
+
+struct midiqueue {
+  midimsg msg[MIDIQ_SIZE];
+  uint8_t head;  // next message to send
+  uint8_t tail;  // next free slot
+};
+
+struct midistat {
+  uint32_t count;  // messages sent
+  uint32_t total_us;  // sum of latencies for the average
+  uint32_t max_us;  // worst latency seen
+  uint32_t coalesced;  // CCs replaced by a newer value before they went out
+  uint32_t dropped;  // queue full
+};
+
+// ------------- active notes -------------
+// one bit per note per channel per port, set when a note on is queued and cleared when its note off is
+// so all_notes_off() can turn off exactly the notes that are sounding and nothing else - on the DIN port
+// a note off for every pitch on every channel would take most of a second
+
+SEQ_STATE uint32_t activenotes[NUM_PORTS][16][4];
+SEQ_STATE uint32_t hungnotes; // notes found sounding that nothing was going to turn off - see findhung()
+
+void __not_in_flash_func(noteactive)(uint8_t port, uint8_t status, uint8_t pitch, uint8_t velocity) {
+  uint32_t *word=&activenotes[port][status & 0x0F][(pitch >> 5) & 3];
+  if (((status & 0xF0) == 0x90) && velocity) *word|=1UL << (pitch & 31);
+  else *word&=~(1UL << (pitch & 31)); // note off or note on with velocity 0
+}
+
+SEQ_STATE midiqueue midiq[NUM_PORTS][NUM_CLASSES];
+SEQ_STATE midistat midistats[NUM_PORTS][NUM_CLASSES];
+SEQ_STATE midistat thrustats[NUM_PORTS]; // thru messages only - time from being read to going out
+SEQ_STATE uint32_t port_busy_until[NUM_PORTS]; // estimated time each port finishes sending what it has been given
+const uint16_t port_us_per_byte[NUM_PORTS] = {1000000/USB_MIDI_BYTES_PER_SEC,1000000/SERIAL_MIDI_BYTES_PER_SEC};
+
+uint8_t __not_in_flash_func(msgclass)(uint8_t status) {
+  if (status >= 0xF8) return CLASS_REALTIME;
+  if ((status & 0xF0) == 0xB0) return CLASS_CC;
+  return CLASS_NOTE;
+}
+
+uint8_t __not_in_flash_func(msglength)(uint8_t status) {
+  if (status >= 0xF8) return 1; // realtime is a single byte
+  if (((status & 0xF0) == 0xC0) || ((status & 0xF0) == 0xD0)) return 2; // program change, channel pressure
+  return MIDI_MSG_BYTES;
+}
+
+// queue a message for a port. now is the current time in us, thru is set for messages passed on from an input
+// returns false if the queue is full
+bool __not_in_flash_func(queuemsg)(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2, uint32_t now, bool thru = false) {
+  uint8_t cls=msgclass(status);
+  midiqueue *q=&midiq[port][cls];
+  if (cls == CLASS_CC) { // a newer value for a controller that is still waiting replaces the old one
+    for (uint8_t i=q->head; i!=q->tail; i=(i+1)&(MIDIQ_SIZE-1)) {
+      if ((q->msg[i].status == status) && (q->msg[i].data1 == data1)) {
+        q->msg[i].data2=data2;
+        ++midistats[port][cls].coalesced;
+        return true;
+      }
+    }
+  }
+  uint8_t next=(q->tail+1)&(MIDIQ_SIZE-1);
+  if (next == q->head) {
+    ++midistats[port][cls].dropped;
+    return false;
+  }
+  q->msg[q->tail].status=status;
+  q->msg[q->tail].data1=data1;
+  q->msg[q->tail].data2=data2;
+  q->msg[q->tail].queued_us=now;
+  q->msg[q->tail].thru=thru;
+  q->tail=next;
+  tickbytes[port]+=msglength(status);
+  if ((status & 0xE0) == 0x80) noteactive(port,status,data1,data2); // note on and note off
+  return true;
+}
+
+// estimated time in us until a port has sent everything written to it
+uint32_t __not_in_flash_func(portbacklog)(uint8_t port, uint32_t now) {
+  int32_t backlog=(int32_t)(port_busy_until[port]-now);
+  return (backlog > 0) ? backlog : 0;
+}
+
+// drop everything waiting for a port - used when USB is plugged in or pulled out so nothing stale goes out
+// whatever was sounding went with the old connection
+void resetport(uint8_t port, uint32_t now) {
+  for (uint8_t cls=0; cls<NUM_CLASSES;++cls) midiq[port][cls].head=midiq[port][cls].tail;
+  memset(activenotes[port],0,sizeof(activenotes[port]));
+  port_busy_until[port]=now;
+}
+
+// take the next message to write to a port, highest priority first
+// returns false if there is nothing that should go out right now
+// updates the port's drain estimate and the latency stats - latency is queue time plus time waiting behind earlier bytes
+bool __not_in_flash_func(nextmsg)(uint8_t port, uint32_t now, midimsg *m) {
+  uint32_t backlog=portbacklog(port,now);
+  for (uint8_t cls=0; cls<NUM_CLASSES;++cls) {
+    midiqueue *q=&midiq[port][cls];
+    if (q->head == q->tail) continue;
+    if ((cls == CLASS_CC) && (backlog > CC_MAX_BACKLOG_US)) return false; // CCs wait till the port catches up
+    *m=q->msg[q->head];
+    q->head=(q->head+1)&(MIDIQ_SIZE-1);
+    uint32_t start=now+backlog;  // when the first byte actually goes out
+    port_busy_until[port]=start+msglength(m->status)*port_us_per_byte[port];
+    uint32_t latency=start-m->queued_us;
+    midistat *st=&midistats[port][cls];
+    ++st->count;
+    st->total_us+=latency;
+    if (latency > st->max_us) st->max_us=latency;
+    if (m->thru) {
+      st=&thrustats[port];
+      ++st->count;
+      st->total_us+=latency;
+      if (latency > st->max_us) st->max_us=latency;
+    }
+    return true;
+  }
+  return false;
+}
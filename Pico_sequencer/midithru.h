@@ -0,0 +1,48 @@
+// MIDI thru and merge - a keyboard on either port can play the synths without a separate merge box
+// core 1 reads each message whole - the MIDI library has already expanded running status - and queues it on the
+// output ports like a sequencer note so thru and sequencer output merge a message at a time and never split
+// each route from an input port to an output port has a filter - a channel mask for each message type - so deciding
+// whether a message goes out is one table lookup. system exclusive and system common messages are not passed
+
+enum THRUDESTS {THRU_OFF,THRU_USB,THRU_DIN,THRU_BOTH}; // bit per output port - set in the note menu
+
+#define MIDI_READ_MAX 8  // messages read from each port per loop1() pass so a flood of input can't hold up the clock
+#define THRU_ALL_CHANNELS 0xFFFF
+#define THRU_REALTIME 7  // filter slot for clock, start, stop etc. bit 0 passes them
+
+// input port to output port filter, one slot per message type 0x8n-0xEn then realtime. a set bit passes that channel
+uint16_t thrufilter[NUM_PORTS][NUM_PORTS][8];
+
+uint8_t thrudest[NUM_PORTS]; // THRU_OFF etc for each input port
+uint8_t thruchannel[NUM_PORTS]; // channel passed from each input port, 0 for all
+
+// menu handler - rebuild the filter table from the menu settings
+// channel messages on the chosen channels go thru. realtime stays behind - the sequencer sends its own clock
+void setthru(void) {
+  for (uint8_t in=0; in<NUM_PORTS;++in) {
+    uint16_t channels=thruchannel[in] ? 1 << (thruchannel[in]-1) : THRU_ALL_CHANNELS;
+    for (uint8_t out=0; out<NUM_PORTS;++out) {
+      bool routed=bitRead(thrudest[in],out);
+      for (uint8_t type=0; type<THRU_REALTIME;++type) thrufilter[in][out][type]=routed ? channels : 0; // one store each
+      thrufilter[in][out][THRU_REALTIME]=0;
+    }
+  }
+}
+
+// core 1 - pass a message that came in on a port to whichever ports its routes let it thru to
+// notes are played thru on the track's channel while recording so they aren't sent twice. transpose keys aren't played
+void __not_in_flash_func(midithru)(uint8_t in, uint8_t status, uint8_t data1, uint8_t data2) {
+  if ((status < 0x80) || ((status >= 0xF0) && (status < 0xF8))) return;
+  bool note=((status & 0xF0) == midi::NoteOn) || ((status & 0xF0) == midi::NoteOff);
+  if (note && ((recordmode != REC_OFF) || bitRead(transposechannels,status & 0x0F))) return;
+  uint8_t type=(status >> 4) & 7; // 0x8n-0xFn to 0-7
+  uint16_t channel=(status < 0xF0) ? 1 << (status & 0x0F) : 1;
+  uint32_t now=micros();
+  bool sent=false;
+  for (uint8_t out=0; out<NUM_PORTS;++out) {
+    if ((thrufilter[in][out][type] & channel) && portenabled(out)) sent|=queuemsg(out,status,data1,data2,now,true);
+  }
+  if (!sent) return;
+  if ((status & 0xF0) == midi::NoteOn) holdkey(data1,data2 != 0); // notes held on the keyboard aren't hung
+  else if ((status & 0xF0) == midi::NoteOff) holdkey(data1,false);
+}
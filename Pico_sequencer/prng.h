@@ -0,0 +1,29 @@
+// small fast random numbers - each track has its own seed so its random choices can be reproduced
+// counter based - a random number is a hash of the track's seed, the lane and the step number so there is no
+// generator state to step along. that way any song position can be jumped to directly and still play the same
+// a few multiplies and shifts per number and no division, unlike random() which goes thru libc rand()
+// no Arduino calls in here so a host render with the same seed gives the same performance as the hardware
+
+SEQ_STATE uint32_t rngkey[NTRACKS]; // scrambled seed for each track
+
+// murmur3 finalizer - nearby inputs give unrelated outputs
+uint32_t rngmix(uint32_t z) {
+  z=(z ^ (z >> 16))*0x85EBCA6B;
+  z=(z ^ (z >> 13))*0xC2B2AE35;
+  return z ^ (z >> 16);
+}
+
+// set a track's random numbers from a seed
+void rngseed(uint8_t track, uint32_t seed) {
+  rngkey[track]=rngmix(seed+(track+1)*0x9E3779B9);
+}
+
+// random number for step n of a lane on a track, 0 to 2^32-1. always the same for the same seed, lane and step
+uint32_t __not_in_flash_func(rngat)(uint8_t track, uint8_t lane, uint32_t n) {
+  return rngmix(rngkey[track] ^ rngmix(n*0x9E3779B9+lane));
+}
+
+// random number 0 to range-1 using a multiply instead of a divide
+uint16_t rngrange(uint8_t track, uint8_t lane, uint32_t n, uint16_t range) {
+  return ((uint64_t)rngat(track,lane,n)*range) >> 32;
+}
@@ -0,0 +1,48 @@
+// RAM budget per subsystem
+// sizes are checked at compile time so the build fails if a subsystem grows past its budget
+// and the actual numbers are reported on the serial port at startup in debug builds
+// budgets are sized for NTRACKS=16 - the RP2040 has 264K but the display, USB stack and heap need their share
+
+#define RAM_BUDGET_PATTERNS   8192  // all step sequencer lanes for all tracks
+#define RAM_BUDGET_TRACKSTATE 1024  // per track note timing state
+#define RAM_BUDGET_SETTINGS    320  // per track menu settings
+#define RAM_BUDGET_MENUS       256  // menu navigation state
+#define RAM_BUDGET_ENCODERS   1024  // encoder objects
+#define RAM_BUDGET_MIDIOUT    4096  // output scheduler queues and stats
+#define RAM_BUDGET_EVENTS    12288  // timed note event queue
+#define RAM_BUDGET_INPUT       512  // MIDI input queue for recording
+#define RAM_BUDGET_SYSEX      4608  // SysEx restore buffer - a copy of the patterns and settings - and dump progress
+#define RAM_BUDGET_LOG        4096  // deferred debug log ring - debug builds only
+
+const size_t ram_patterns = sizeof(notes)+sizeof(offsets)+sizeof(gates)+sizeof(ratchets)+sizeof(velocities)+sizeof(probability)+sizeof(mods)+sizeof(timing);
+const size_t ram_trackstate = sizeof(active_note)+sizeof(active_velocity)+sizeof(tie)+sizeof(noteoff_due)+sizeof(notegen)+sizeof(cut_us)+sizeof(prerendered)+sizeof(rngkey)+sizeof(songtick)+sizeof(midisubticks)+sizeof(renderlead_us)+sizeof(lastCC)+sizeof(playheads)+sizeof(playheadseq)+sizeof(playheadsmoved)+sizeof(nextroot)+sizeof(quantshift)+sizeof(quantfor)+sizeof(quantsel);
+const size_t ram_settings = sizeof(MIDIchannel)+sizeof(CCchannel)+sizeof(trackenabled)+sizeof(mod_enabled)+sizeof(mod_ramp)+sizeof(current_scale)+sizeof(swing)+sizeof(ratchetgate)+sizeof(ratchetramp)+sizeof(seeds)+sizeof(eucmask)+sizeof(fillmask)+sizeof(fillmode)+sizeof(outputdelay)+sizeof(bpm)+sizeof(useMIDIclock)+sizeof(transposechan)+sizeof(transposechannels);
+const size_t ram_menus = sizeof(submenuindex)+sizeof(topmenu)+sizeof(topmenuindex);
+const size_t ram_encoders = sizeof(enc)+sizeof(menuenc);
+const size_t ram_events = sizeof(eventq);
+const size_t ram_input = sizeof(inputq)+sizeof(inputhead)+sizeof(inputtail)+sizeof(inputdrops)+sizeof(recordmode)+sizeof(recordstep)+sizeof(recordpitch)+sizeof(recordtick)+sizeof(recordgate)+sizeof(echochannel)+sizeof(heldkeys);
+const size_t ram_sysex = sizeof(restorebuf)+sizeof(dumprequested)+sizeof(restoredone)+sizeof(dumpnext)+sizeof(restorenext)+sizeof(sysexerrors)+sizeof(dumpssent)+sizeof(restoresdone);
+#ifdef SERIAL_DEBUG
+const size_t ram_log = sizeof(logring);
+#else
+const size_t ram_log = 0;
+#endif
+const size_t ram_midiout = sizeof(midiq)+sizeof(midistats)+sizeof(port_busy_until)+sizeof(tickbytes)+sizeof(activenotes)+sizeof(hungnotes)+sizeof(thrustats)+sizeof(thrufilter)+sizeof(thrudest)+sizeof(thruchannel);
+
+static_assert(ram_patterns <= RAM_BUDGET_PATTERNS, "sequencer patterns over RAM budget");
+static_assert(ram_trackstate <= RAM_BUDGET_TRACKSTATE, "track state over RAM budget");
+static_assert(ram_settings <= RAM_BUDGET_SETTINGS, "settings over RAM budget");
+static_assert(ram_menus <= RAM_BUDGET_MENUS, "menu state over RAM budget");
+static_assert(ram_encoders <= RAM_BUDGET_ENCODERS, "encoders over RAM budget");
+static_assert(ram_events <= RAM_BUDGET_EVENTS, "event queue over RAM budget");
+static_assert(ram_midiout <= RAM_BUDGET_MIDIOUT, "MIDI output over RAM budget");
+static_assert(ram_input <= RAM_BUDGET_INPUT, "MIDI input over RAM budget");
+static_assert(ram_sysex <= RAM_BUDGET_SYSEX, "SysEx dump over RAM budget");
+static_assert(ram_log <= RAM_BUDGET_LOG, "debug log over RAM budget");
+
+// print RAM use vs budget for each subsystem
+void ramreport(void) {
+  Serial.printf("RAM use/budget: patterns %u/%u trackstate %u/%u settings %u/%u menus %u/%u encoders %u/%u midiout %u/%u events %u/%u input %u/%u sysex %u/%u log %u/%u display %u\n",
+    (unsigned)ram_patterns,RAM_BUDGET_PATTERNS,(unsigned)ram_trackstate,RAM_BUDGET_TRACKSTATE,(unsigned)ram_settings,RAM_BUDGET_SETTINGS,
+    (unsigned)ram_menus,RAM_BUDGET_MENUS,(unsigned)ram_encoders,RAM_BUDGET_ENCODERS,(unsigned)ram_midiout,RAM_BUDGET_MIDIOUT,(unsigned)ram_events,RAM_BUDGET_EVENTS,(unsigned)ram_input,RAM_BUDGET_INPUT,(unsigned)ram_sysex,RAM_BUDGET_SYSEX,(unsigned)ram_log,RAM_BUDGET_LOG,SCREEN_BUFFER_SIZE);
+}
@@ -0,0 +1,161 @@
+// live note recording from a keyboard on USB or DIN into the current track's note, velocity and gate lanes
+// core 1 reads MIDI so it timestamps each note with the song position it was heard at and plays it straight back out
+// on the track's channel so you hear what you play. the note goes to core 0 thru a ring buffer and core 0 writes it
+// into the lanes - one writer (core 1) and one reader (core 0) so the ring needs no locks and playback never waits
+// live recording drops each note on the nearest step of each lane's own grid and the note off sets the gate length
+// step recording writes each note into the next step whether the sequencer is running or not
+// a track can also be transposed from the keyboard - a note on its transpose channel becomes its root from the next step
+
+enum RECORDMODES {REC_OFF,REC_LIVE,REC_STEP};
+
+#define INPUTQ_SIZE 32  // notes - must be a power of 2
+
+struct inputnote {
+  int32_t tick;  // song tick it was heard at, -1 when the sequencer isn't running
+  uint8_t status;  // note on or note off with channel
+  uint8_t pitch;
+  uint8_t velocity;
+};
+
+inputnote inputq[INPUTQ_SIZE];
+volatile uint16_t inputhead; // next note to write - only core 1 changes it
+volatile uint16_t inputtail; // next note to record - only core 0 changes it
+volatile uint32_t inputdrops; // notes lost because core 0 fell behind
+
+uint8_t recordmode; // REC_OFF etc - set in the note menu, applies to the current track
+int8_t recordstep; // next step to write when step recording
+int8_t recordpitch=-1; // note being held when live recording - its note off sets the gate length
+int32_t recordtick; // and the song tick it started on
+int8_t recordgate; // gate step it went into
+uint8_t echochannel[128]; // MIDI channel each key was played back out on, 0 if its echo isn't sounding - only core 1 uses it
+
+uint8_t transposechan[NTRACKS]; // MIDI channel that transposes each track, 0 for off - set in the note menu
+uint16_t transposechannels; // bit per channel that transposes any track, bit 0 is channel 1
+
+// menu handler
+void settranspose(void) {
+  uint16_t channels=0;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if (transposechan[track]) channels|=1 << (transposechan[track]-1);
+  }
+  transposechannels=channels;
+}
+
+// core 1 - a note on a transpose channel. the quantizer for the new key is worked out now so the step that picks
+// it up in renderstep() only swaps it in. nothing here needs core 0 so it never waits for the UI
+void __not_in_flash_func(transposeby)(byte channel, byte pitch) {
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if (transposechan[track] != channel) continue;
+    uint8_t root=constrain(pitch,1,115); // same range as the menu
+    preparequant(track,root);
+    nextroot[track]=root;
+  }
+}
+
+// song tick a note played now was heard at. ticks are rendered ahead of their grid time and the track's output delay
+// moves when it is heard so we go back from the grid time of the last tick rendered
+int32_t __not_in_flash_func(inputtick)(uint32_t now) {
+  if ((controlstate != RUNNING) && (controlstate != RUNJUSTSYNCED)) return -1;
+  int32_t period=clockperiod_us();
+  int32_t since=(int32_t)(now-outputdelay_us(current_track)-clocktimer); // clocktimer is the grid time of songtick-1
+  int32_t half=since+period/2;
+  int32_t tick=(int32_t)songtick-1+((half >= 0) ? half/period : -((period-1-half)/period)); // floor - since is negative for an early note
+  return (tick < 0) ? 0 : tick;
+}
+
+// core 1 - MIDI note handlers for both ports. MIDI library channels are 1-16
+// the note is sent back out on the track being recorded right away - it goes out with this pass of loop1()
+// the echo is turned off on the channel it went out on, even if REC was turned off or the track changed since
+void __not_in_flash_func(handleNoteOn)(byte channel, byte pitch, byte velocity) {
+  if (bitRead(transposechannels,channel-1)) { // transpose keys aren't recorded
+    if (velocity) transposeby(channel,pitch);
+    return;
+  }
+  if (echochannel[pitch]) { // key's echo still sounding - a note off ends it and a new note on retriggers it
+    noteOff(echochannel[pitch]-1,pitch,0);
+    echochannel[pitch]=0;
+    if (!velocity) holdkey(pitch,false);
+  }
+  if (recordmode == REC_OFF) return;
+  uint8_t status=velocity ? midi::NoteOn : midi::NoteOff; // note on with velocity 0 is a note off
+  if (velocity) {
+    echochannel[pitch]=MIDIchannel[current_track];
+    noteOn(echochannel[pitch]-1,pitch,velocity);
+  }
+  holdkey(pitch,velocity != 0);
+  uint16_t head=inputhead;
+  if ((uint16_t)(head-inputtail) >= INPUTQ_SIZE) {
+    ++inputdrops;
+    return;
+  }
+  inputnote *n=&inputq[head & (INPUTQ_SIZE-1)];
+  n->tick=inputtick(micros());
+  n->status=status | (channel-1);
+  n->pitch=pitch;
+  n->velocity=velocity;
+  __sync_synchronize(); // note is complete before core 0 can see it
+  inputhead=head+1;
+}
+
+void __not_in_flash_func(handleNoteOff)(byte channel, byte pitch, byte velocity) {
+  (void)velocity;
+  handleNoteOn(channel,pitch,0);
+}
+
+// step of a lane nearest to song tick t - a copy of the lane is positioned there so core 1's lane isn't touched
+int8_t recordindex(uint8_t track, uint8_t lane, int32_t tick) {
+  sequencer seq=*getlane(track,lane);
+  int16_t div=divtable[seq.divider];
+  seqseek(&seq,track,lane,(tick+div/2)/div*div);
+  return seq.index;
+}
+
+// write a played note into one step of each lane
+// every write is a single store - values are a byte and step masks are one store - so core 1 doesn't have to stop
+void recordnote(uint8_t track, int8_t ni, int8_t vi, int8_t gi, uint8_t pitch, uint8_t velocity) {
+  notes[track].val[ni]=constrain((int16_t)pitch-notes[track].root,-notes[track].max,notes[track].max);
+  notes[track].active|=1 << ni;
+  velocities[track].val[vi]=constrain((velocity+VELOCITYSCALE/2)/VELOCITYSCALE,1,VELOCITYRANGE);
+  gates[track].active|=1 << gi;
+}
+
+// menu handler - start step recording from the first step and forget any note that was being held
+void startrecord(void) {
+  recordstep=notes[current_track].first;
+  recordpitch=-1;
+}
+
+// core 0 - record the notes core 1 has read. returns true if a lane of the current track changed
+bool recordflush(void) {
+  bool changed=false;
+  uint8_t track=current_track;
+  while (inputtail != inputhead) {
+    __sync_synchronize(); // see the note core 1 finished before it moved inputhead
+    inputnote n=inputq[inputtail & (INPUTQ_SIZE-1)];
+    __sync_synchronize(); // done with the note before core 1 can reuse it
+    inputtail=inputtail+1;
+    bool on=(n.status & 0xF0) == midi::NoteOn;
+    if (recordmode == REC_STEP) {
+      if (!on) continue;
+      recordnote(track,recordstep,recordstep,recordstep,n.pitch,n.velocity);
+      recordstep=(recordstep >= notes[track].last) ? notes[track].first : recordstep+1;
+      changed=true;
+    }
+    else if ((recordmode == REC_LIVE) && (n.tick >= 0)) {
+      if (on) {
+        recordgate=recordindex(track,GATE_LANE,n.tick);
+        recordnote(track,recordindex(track,NOTE_LANE,n.tick),recordindex(track,VELOCITY_LANE,n.tick),recordgate,n.pitch,n.velocity);
+        recordpitch=n.pitch;
+        recordtick=n.tick;
+        changed=true;
+      }
+      else if (n.pitch == recordpitch) { // held for this fraction of a gate step. a whole step or more ties it over
+        int16_t div=divtable[gates[track].divider];
+        gates[track].val[recordgate]=constrain(((n.tick-recordtick)*GATERANGE+div/2)/div,1,GATERANGE);
+        recordpitch=-1;
+        changed=true;
+      }
+    }
+  }
+  return changed;
+}
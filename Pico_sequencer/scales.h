@@ -12,8 +12,8 @@
 #define LYDIAN 0xad5
 #define MIXOLYDIAN 0x6b5
 
-uint16_t scales[] ={CHROMATIC,MAJOR,MINOR,HARMONIC_MINOR,MAJOR_PENTATONIC,MINOR_PENTATONIC,DORIAN,PHRYGIAN,LYDIAN,MIXOLYDIAN};
-int16_t current_scale[NTRACKS]={1,1,1,1}; // index of scale in use for each track
+const uint16_t scales[] ={CHROMATIC,MAJOR,MINOR,HARMONIC_MINOR,MAJOR_PENTATONIC,MINOR_PENTATONIC,DORIAN,PHRYGIAN,LYDIAN,MIXOLYDIAN};
+SEQ_STATE uint8_t current_scale[NTRACKS]={FOR_EACH_TRACK(TRACK_ONE)}; // index of scale in use for each track - major by default
 
 uint16_t rotate12left(uint16_t n, uint16_t d) {
   return 0xfff & ((n << (d % 12)) | (n >> (12 - (d % 12))));
@@ -24,7 +24,7 @@ uint16_t rotate12right(uint16_t n, uint16_t d) {
 }
 
 // quantize MIDI notes 0-128 to scale with given MIDI root note 0-128
-uint8_t quantize(uint8_t note, uint16_t scale,uint8_t root){
+uint8_t __not_in_flash_func(quantize)(uint8_t note, uint16_t scale,uint8_t root){
   uint8_t n = note%12; // reduce to one octave
   uint8_t key = root%12;
   scale=rotate12left(scale,key); // adjust scale mask into the right key
@@ -35,3 +35,36 @@ uint8_t quantize(uint8_t note, uint16_t scale,uint8_t root){
   }
   return note; // failed to quantize - should not happen for most scales
 }
+
+// quantizer lookup - how far up each pitch class moves to land in a track's scale and key, so quantizing a note is
+// one table read. each track has two copies - a new key is worked out into the spare copy when it is asked for and
+// swapped in with one store when it takes effect, so the note that plays it doesn't pay for working it out
+// quantfor is the scale*12+key each copy holds. a scale or root changed from the menu is caught on the next note
+SEQ_STATE uint8_t quantshift[NTRACKS][2][12];
+SEQ_STATE uint8_t quantfor[NTRACKS][2]; // all 0 ie chromatic in C - which is what all 0 shifts are
+SEQ_STATE uint8_t quantsel[NTRACKS]; // copy in use
+
+void __not_in_flash_func(buildquant)(uint8_t track, uint8_t copy, uint8_t root) {
+  for (uint8_t pc=0; pc<12;++pc) quantshift[track][copy][pc]=quantize(pc,scales[current_scale[track]],root)-pc;
+  quantfor[track][copy]=current_scale[track]*12+root%12;
+}
+
+// core 1 - quantize a note to the track's scale in the key of root
+uint8_t __not_in_flash_func(quantnote)(uint8_t track, uint8_t note, uint8_t root) {
+  uint8_t sel=quantsel[track];
+  if (quantfor[track][sel] != current_scale[track]*12+root%12) buildquant(track,sel,root);
+  return note+quantshift[track][sel][note%12];
+}
+
+// core 1 - work out the spare copy for a new root. the same scale in another key is the table rotated
+void __not_in_flash_func(preparequant)(uint8_t track, uint8_t root) {
+  uint8_t sel=quantsel[track];
+  uint8_t from=quantfor[track][sel];
+  if (from/12 != current_scale[track]) {
+    buildquant(track,sel^1,root);
+    return;
+  }
+  uint8_t d=(root%12+12-from%12)%12; // semitones the key moves up
+  for (uint8_t pc=0; pc<12;++pc) quantshift[track][sel^1][pc]=quantshift[track][sel][(pc+12-d)%12];
+  quantfor[track][sel^1]=current_scale[track]*12+root%12;
+}
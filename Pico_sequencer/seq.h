@@ -1,28 +1,74 @@
 // sequencer related definitions and structures
 
 #define SEQ_STEPS 16 // 16 step sequencer
+#define ALL_STEPS 0xFFFF  // step mask with every step on
 #define NOTERANGE 12 // notes can be +- one octave from root - display limitation
 #define GATERANGE 7  // gate time 0-7 ie 12.5% increments
 #define VELOCITYRANGE 32  // velocity has 32 steps ie 2.5% per step. makes spinning the encoder less tedious
 #define VELOCITYSCALE 4 // 32*4=128 which we limit to 127 
 #define PROBABILITYRANGE 9  // probability 0-9 ie 10% increments
-#define RATCHETRANGE 3 // number of ratchets/repeats per step 0-3
+#define RATCHETRANGE 15 // number of ratchets/repeats per step 0-15 ie up to 16 hits
 #define MODRANGE 127  // modulation range 0-127
+#define TIMINGRANGE 8  // timing offsets are +- 8 sixteenths of a step ie up to half a step early or late
+#define SWINGRANGE 50  // swing delays odd steps by up to 50% of a step
 
 // clock related stuff
 enum STEPMODE {FORWARD,BACKWARD,PINGPONG,RANDOMWALK,RANDOM};
-
-long clocktimer = 0; // clock rate in ms
-long notetimer[NTRACKS]={0,0,0,0}; // note off timer
-int16_t active_note[NTRACKS]; // note # note in progress, 0 if no note sounding
-int16_t active_velocity[NTRACKS]; // velocity of the active note
-int16_t active_notelength[NTRACKS]; //length of the active note in ms
-bool tie[NTRACKS];  // flag that a tied note is in progress
-int16_t ratchetcnt[NTRACKS]; // number of ratchets for the note 
+enum LANES {NOTE_LANE,OFFSET_LANE,GATE_LANE,VELOCITY_LANE,PROBABILITY_LANE,RATCHET_LANE,TIMING_LANE,MOD_LANE,NUM_LANES}; // also keeps each lane's random numbers apart
+
+SEQ_STATE uint32_t clocktimer = 0; // time of the last internal clock tick in us
+SEQ_STATE int16_t active_note[NTRACKS]; // note # of the last note played on the track
+SEQ_STATE int16_t active_velocity[NTRACKS]; // velocity of the active note
+SEQ_STATE bool tie[NTRACKS];  // flag that a tied note is in progress - it has no note off scheduled until a later step ends it
+SEQ_STATE uint32_t noteoff_due[NTRACKS]; // when the last scheduled note off for the track goes out
+SEQ_STATE uint8_t notegen[NTRACKS]; // bumped when a note is cut short by the next one so its leftover events are dropped
+#define NOTEGENS 2 // cut times kept per track - a note is over within a step and the note after next starts at least a step later
+SEQ_STATE uint32_t cut_us[NTRACKS][NOTEGENS]; // when each of the last few generations was cut short
+SEQ_STATE bool prerendered[NTRACKS]; // the next gate step has already been rendered because it plays early
+SEQ_STATE uint8_t swing[NTRACKS]; // swing amount in % of a step for each track
+#define RATCHET_GATE_INIT(track,number) 50,
+SEQ_STATE uint8_t ratchetgate[NTRACKS] = {FOR_EACH_TRACK(RATCHET_GATE_INIT)}; // length of each ratchet hit in % of the hit spacing
+SEQ_STATE int8_t ratchetramp[NTRACKS]; // velocity change from first to last ratchet hit in % ie -50 fades to half velocity
+SEQ_STATE int16_t seeds[NTRACKS] = {FOR_EACH_TRACK(TRACK_NUMBER)}; // random seed for each track - same seed, same performance
+#define ALL_STEPS_INIT(track,number) ALL_STEPS,
+SEQ_STATE uint16_t eucmask[NTRACKS] = {FOR_EACH_TRACK(ALL_STEPS_INIT)}; // euclidean rhythm over the probability lane's steps
+SEQ_STATE uint16_t fillmask[NTRACKS]; // gate steps that play no matter what while a fill is on. 0 is no fill
+SEQ_STATE uint8_t fillmode[NTRACKS]; // fill pattern picked in the gate menu - see setfill()
+#define OUTPUTDELAY_US 100 // output delays are set in 0.1 ms steps
+#define OUTPUTDELAY_MAX 500 // +-50 ms
+SEQ_STATE int16_t outputdelay[NTRACKS]; // output delay in 0.1 ms, negative sends the track early. lines tracks up at the synths
+#define NO_ROOT_INIT(track,number) -1,
+SEQ_STATE int8_t nextroot[NTRACKS] = {FOR_EACH_TRACK(NO_ROOT_INIT)}; // root a transpose key asked for, -1 for none. see transposeby()
+
+// probability value 0-9 as a threshold for a 32 bit random number so a probability check is a single compare
+// the random number has its low bit set so 0% never plays and 100% always does
+#define PROBTHRESHOLD(p) (uint32_t)((0xFFFFFFFFULL*(p))/PROBABILITYRANGE)
+const uint32_t probthreshold[PROBABILITYRANGE+1] = {PROBTHRESHOLD(0),PROBTHRESHOLD(1),PROBTHRESHOLD(2),PROBTHRESHOLD(3),PROBTHRESHOLD(4),
+  PROBTHRESHOLD(5),PROBTHRESHOLD(6),PROBTHRESHOLD(7),PROBTHRESHOLD(8),PROBTHRESHOLD(9)};
+// the engine runs at PPQN internally and MIDI clock is always 24 per quarter note
+#define CLOCKS_PER_MIDI_CLOCK (PPQN/MIDI_PPQN)
+#define MIDICLOCKS(n) ((n)*CLOCKS_PER_MIDI_CLOCK)  // lane dividers are written in MIDI clocks
 // const char * textrates[] = {" 8x"," 6x"," 4x"," 3x", " 2x","1.5x"," 1x","/1.5"," /2"," /3"," /4"," /5"," /6"," /7"," /8"," /9"," /10"," /11"," /12"," /13"," /14"," /15"," /16"," /32"," /64"," /128"};
-int16_t divtable[] = {3,4,6,8,12,16,24,36,48,72,96,120,144,168,192,216,240,264,288,312,336,360,384,768,1536,3072};
-
-int16_t lastCC[NTRACKS]; // we save the last CC message - reduce MIDI traffic by not sending the same message twice 
+const int16_t divtable[] = {MIDICLOCKS(3),MIDICLOCKS(4),MIDICLOCKS(6),MIDICLOCKS(8),MIDICLOCKS(12),MIDICLOCKS(16),MIDICLOCKS(24),
+  MIDICLOCKS(36),MIDICLOCKS(48),MIDICLOCKS(72),MIDICLOCKS(96),MIDICLOCKS(120),MIDICLOCKS(144),MIDICLOCKS(168),MIDICLOCKS(192),
+  MIDICLOCKS(216),MIDICLOCKS(240),MIDICLOCKS(264),MIDICLOCKS(288),MIDICLOCKS(312),MIDICLOCKS(336),MIDICLOCKS(360),MIDICLOCKS(384),
+  MIDICLOCKS(768),MIDICLOCKS(1536),MIDICLOCKS(3072)};
+SEQ_STATE uint8_t midisubticks; // internal ticks still to run before the next MIDI clock comes in
+
+SEQ_STATE uint32_t ticktime_us; // time taken by the last clocktick() call in us
+SEQ_STATE uint32_t ticktime_max_us; // worst case clocktick() time since startup
+SEQ_STATE uint32_t emitcount; // note events sent
+SEQ_STATE uint32_t emitlate_us; // how late the last note event went out vs its deadline
+SEQ_STATE uint32_t emitlate_max_us; // worst case since startup
+
+// internal clock ticks are rendered at least this far ahead of their grid time so working out a step never delays a note
+// live edits are heard within this plus a tick
+#define LOOKAHEAD_US 3000
+#define EMIT_MARGIN_US 50  // a render doesn't start if a note is due within the last tick's render time plus this
+SEQ_STATE uint32_t renderlead_us=LOOKAHEAD_US; // how far ahead ticks are rendered - the lookahead plus the biggest output advance
+
+SEQ_STATE int8_t lastCC[NUM_PORTS][NTRACKS]; // we save the last CC message per port - reduce MIDI traffic by not sending the same message twice 
+SEQ_STATE uint8_t ramp_rr[NUM_PORTS]; // track that gets first shot at the leftover bandwidth on each port next tick
 
 // all of the sequences use the same data structure even though the data is somewhat different in each case
 // this simplifies the code somewhat
@@ -30,589 +76,555 @@ int16_t lastCC[NTRACKS]; // we save the last CC message - reduce MIDI traffic by
 // note that there are two threads of execution running on the two Pico cores - UI and note handling
 // must be careful about editing items that are used by the 2nd Pico core for note timing etc
 
+// everything except the clock counter and step masks fits in a byte which halves the pattern RAM. the menus bind to these as BIND_INT8
+// step masks have one bit per step, bit 0 is step 1. a mask is written in one store so core 1 can read it while core 0 edits it
 struct sequencer {
-  int16_t val[SEQ_STEPS];  // values of note offsets from root, gate lengths etc. 
-  int16_t active[SEQ_STEPS];  // step active or not. possible values : 1=active, 0=deactivated, -1=cannot be changed
-  int16_t max;    // maximum positive value of val - used for UI scaling
-  int16_t index;    // index of step we are on
-  int16_t stepmode;    // step mode - fwd, backward etc
-  int16_t state;    // state - used for step modes  
-  int16_t first;  // first step used - anything used my the menusystem has to be integer type
-  int16_t last;   // last step used
-  int16_t euclen;   // euclidean length
-  int16_t eucbeats;   // euclidean beats
-  int16_t divider;   // clock rate divider - lookup via table
-  int16_t clockticks;   //  clock counter
-  int16_t root;   // "root" note - note offsets are relative to this. also used for euclidean offset and CC number
+  int8_t val[SEQ_STEPS];  // values of note offsets from root, gate lengths etc. 
+  uint16_t active;  // steps that are switched on
+  int8_t max;    // maximum positive value of val - used for UI scaling
+  int8_t index;    // index of step we are on
+  int8_t stepmode;    // step mode - fwd, backward etc
+  int8_t state;    // state - used for step modes  
+  int8_t first;  // first step used
+  int8_t last;   // last step used
+  int8_t euclen;   // euclidean length
+  int8_t eucbeats;   // euclidean beats
+  int8_t divider;   // clock rate divider - lookup via table
+  int8_t root;   // "root" note - note offsets are relative to this. also used for euclidean offset and CC number
+  int16_t clockticks;   //  ticks till the next step - up to 12288 so it needs 16 bits
 };
 
+// initializer for one track of a sequencer array - 16 steps of val, 16 of active and the rest of the struct
+#define SEQ_FILL(v) v,v,v,v,v,v,v,v,v,v,v,v,v,v,v,v
+#define SEQ_INIT(val,max,root) { \
+  {SEQ_FILL(val)},  /* initial data */ \
+  ALL_STEPS,  /* all steps on */ \
+  max,  /* maximum value */ \
+  0,   /* step index */ \
+  FORWARD, /* step mode */ \
+  0,     /* state - used for step modes */ \
+  0,   /* first step */ \
+  SEQ_STEPS-1,  /* last step */ \
+  SEQ_STEPS, /* euclidean length */ \
+  1, /* euclidean beats */ \
+  6,  /* clock divide */ \
+  root,   /* root note */ \
+  1,    /* clock counter - first tick plays step 0 */ \
+},
+
 // notes are stored as offsets from the root 
-sequencer notes[NTRACKS] = {
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+#define NOTES_INIT(track,number) SEQ_INIT(0,NOTERANGE,60)  // all steps active by default
+SEQ_STATE sequencer notes[NTRACKS] = { FOR_EACH_TRACK(NOTES_INIT) };
 
 // offsets (translations) are added to the current note
-sequencer offsets[NTRACKS] = {
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+#define OFFSETS_INIT(track,number) SEQ_INIT(0,NOTERANGE,60)
+SEQ_STATE sequencer offsets[NTRACKS] = { FOR_EACH_TRACK(OFFSETS_INIT) };
 
-sequencer gates[NTRACKS] = {
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // gates may not be deactivated
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // gates may not be deactivated
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // gates may not be deactivated
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // gates may not be deactivated
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+#define GATES_INIT(track,number) SEQ_INIT(3,GATERANGE,60)  // switching a gate step off mutes it
+SEQ_STATE sequencer gates[NTRACKS] = { FOR_EACH_TRACK(GATES_INIT) };
 
-sequencer ratchets[NTRACKS] = {
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+#define RATCHETS_INIT(track,number) SEQ_INIT(0,RATCHETRANGE,60)
+SEQ_STATE sequencer ratchets[NTRACKS] = { FOR_EACH_TRACK(RATCHETS_INIT) };
 
 // velocities have MIDI values 0-127 
-sequencer velocities[NTRACKS] = {
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+#define VELOCITIES_INIT(track,number) SEQ_INIT(22,VELOCITYRANGE,60)  // initial setting ~ 80% velocity
+SEQ_STATE sequencer velocities[NTRACKS] = { FOR_EACH_TRACK(VELOCITIES_INIT) };
 
 // probability values 
-sequencer probability[NTRACKS] = {
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data 100% probability
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-};
+#define PROBABILITY_INIT(track,number) SEQ_INIT(9,PROBABILITYRANGE,0)  // 100% probability. root holds euclidean offset in this case
+SEQ_STATE sequencer probability[NTRACKS] = { FOR_EACH_TRACK(PROBABILITY_INIT) };
+
+// timing offsets in 1/16 of a step - negative is early
+#define TIMING_INIT(track,number) SEQ_INIT(0,TIMINGRANGE,0)
+SEQ_STATE sequencer timing[NTRACKS] = { FOR_EACH_TRACK(TIMING_INIT) };
 
 // modulation values 
-sequencer mods[NTRACKS] = {
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  16,   // CC number in this case
-
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  17,   // CC number in this case
-
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  18,   // CC number in this case
-
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  // all steps active by default
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  19,   // CC number in this case
-};
+#define MODS_INIT(track,number) SEQ_INIT(-1,MODRANGE,16+track)  // -1 = don't send. root is the CC number in this case - CC16 for track 1 etc
+SEQ_STATE sequencer mods[NTRACKS] = { FOR_EACH_TRACK(MODS_INIT) };
 
 
 
-// clock a sequencer
+sequencer *getlane(uint8_t track, uint8_t lane) {
+  switch (lane) {
+    case NOTE_LANE: return &notes[track];
+    case OFFSET_LANE: return &offsets[track];
+    case GATE_LANE: return &gates[track];
+    case VELOCITY_LANE: return &velocities[track];
+    case PROBABILITY_LANE: return &probability[track];
+    case RATCHET_LANE: return &ratchets[track];
+    case TIMING_LANE: return &timing[track];
+    default: return &mods[track];
+  }
+}
+
+// every lane's position is worked out from the song position in clock ticks rather than stepped along
+// so jumping to any point in the song is O(1) and lanes can't drift out of phase with each other
+SEQ_STATE uint32_t songtick; // the clock tick being played, counted from the start of the song
+
+// playheads for the UI. core 1 moves the lanes' index while core 0 is drawing them so core 0 never reads them from
+// the lanes. core 1 publishes a copy under a seqlock - playheadseq is odd while it is writing - and core 0 copies it
+// and tries again if the count moved. it only changes when a lane steps so core 0 also knows when to redraw
+SEQ_STATE volatile uint32_t playheadseq;
+SEQ_STATE int8_t playheads[NTRACKS][NUM_LANES];
+SEQ_STATE uint16_t playheadsmoved; // tracks with a lane that stepped since the last publish - core 1 only
+
+// position a lane at song tick t
+// a lane moves one step every divider ticks starting on its first step at tick 0 - step n is played at tick n*divider
+// pingpong runs first..last..first+1 so its cycle is 2*(length-1) steps. random modes use the track's counter based
+// random numbers so they replay the same from any position. random walk has to retrace its steps so it is O(steps)
+void __not_in_flash_func(seqseek)(sequencer *seq, uint8_t track, uint8_t lane, uint32_t tick) {
+  int16_t div=divtable[seq->divider];
+  uint32_t n=tick/div; // steps taken
+  int16_t len=seq->last-seq->first+1;
+  seq->clockticks=div-tick%div; // ticks till the next step
+  switch (seq->stepmode) {
+    case FORWARD:
+      seq->index=seq->first+n%len;
+      break;
+    case BACKWARD:
+      seq->index=seq->first+(len-n%len)%len;
+      break;
+    case PINGPONG:
+      if (len < 2) {
+        seq->index=seq->first;
+        seq->state=FORWARD;
+      }
+      else {
+        uint32_t cycle=2*(len-1);
+        uint32_t pos=n%cycle;
+        seq->index=seq->first+((pos < (uint32_t)len) ? pos : cycle-pos);
+        seq->state=(pos < (uint32_t)(len-1)) ? FORWARD : BACKWARD; // direction of the next step - see nextindex()
+      }
+      break;
+    case RANDOMWALK:
+      seq->index=seq->first;
+      for (uint32_t i=1; i<=n;++i) seq->index=constrain(seq->index+(int16_t)rngrange(track,lane,i,3)-1,seq->first,seq->last);
+      break;
+    case RANDOM:
+      seq->index=n ? seq->first+rngrange(track,lane,n,len) : seq->first; // first to last inclusive
+      break;
+    default:
+      break;
+  }
+}
+
+// clock a sequencer for the current song tick
 // you have to pass a pointer to the sequence structure, not the structure itself
 // this is to allow modifying the contents of the structure - baffled me for a while 
+// track and lane select the random numbers used by the random step modes
 // returns 1 when index changes - in the case of gates this is a note on event
-int16_t seqclock(sequencer *seq) {
-  int16_t event=0;
-  --seq->clockticks;
-  if (seq->clockticks < 1 ) { // divider has rolled over
-    seq->clockticks=divtable[seq->divider];  // lookup table used to get clock divider
-    event=1;
-    switch (seq->stepmode) {
-      case FORWARD:
-        ++seq->index;
-        if (seq->index > seq->last) seq->index=seq->first;
-        break;
-      case BACKWARD:
-        --seq->index;
-        if (seq->index < seq->first) seq->index=seq->last;
-        break;
-      case PINGPONG:
-        if (seq->state == FORWARD) {
-         ++seq->index;
-          if (seq->index > seq->last) {
-            seq->index=seq->last-1;
-            seq->index=constrain(seq->index,seq->first,seq->last);
-            seq->state=BACKWARD;
-          }
-        }
-        else {
-          --seq->index;
-          if (seq->index < seq->first) {
-            seq->index=seq->first+1;
-            seq->index=constrain(seq->index,seq->first,seq->last);
-            seq->state=FORWARD;
-          }
-        }
-        break;
-        case RANDOMWALK:
-          seq->index+=random(-1,2); // range of -1 to +1
-          seq->index=constrain(seq->index,seq->first,seq->last);
-        break;
-        case RANDOM:
-          seq->index=random(seq->first,seq->last);
-        break;        
-      default:
-        break;
-    }
+// most ticks are between steps and only count down - the song position is only worked out on a lane's own rollover
+int16_t __not_in_flash_func(seqclock)(sequencer *seq, uint8_t track, uint8_t lane) {
+  if (--seq->clockticks > 0) return 0; // between steps
+  if ((seq->stepmode == RANDOMWALK) && (songtick > 0)) { // one step on from where it is rather than retracing the walk
+    int16_t div=divtable[seq->divider];
+    seq->index=constrain(seq->index+(int16_t)rngrange(track,lane,songtick/div,3)-1,seq->first,seq->last);
+    seq->clockticks=div-songtick%div; // back on the song grid if the rate was changed
   }
-  return event;
+  else seqseek(seq,track,lane,songtick);
+  playheadsmoved|=1 << track;
+  return 1;
   //Serial.printf("ticks %d stepindex %d \n",seq->clockticks,seq->index);
 }
 
-// clock all the sequencers
-// clockperiod is the period of the 24ppqn clock - used for calculating gate times etc
-// this code got a bit messy after I added multiple tracks
-// it loops thru all tracks, all sequences looking for note on and off events to process
-void clocktick (long clockperiod) {
-  int16_t gatestate,ccval;
+// next step a sequencer will play - used to ramp towards it
+// follows the same rules as seqclock(). random modes can't be predicted so they don't ramp
+int16_t nextindex(sequencer *seq) {
+  switch (seq->stepmode) {
+    case FORWARD:
+      return (seq->index >= seq->last) ? seq->first : seq->index+1;
+    case BACKWARD:
+      return (seq->index <= seq->first) ? seq->last : seq->index-1;
+    case PINGPONG:
+      if (seq->state == FORWARD) return (seq->index >= seq->last) ? constrain(seq->last-1,seq->first,seq->last) : seq->index+1;
+      else return (seq->index <= seq->first) ? constrain(seq->first+1,seq->first,seq->last) : seq->index-1;
+    default:
+      return seq->index;
+  }
+}
+
+// CC value part way between the current step and the next one
+// clockticks counts down from the divider to 1 so the ticks we are into the step is divider-clockticks
+int16_t rampvalue(sequencer *seq) {
+  int16_t from=seq->val[seq->index];
+  int16_t to=seq->val[nextindex(seq)];
+  if ((from < 0) || (to < 0)) return from; // -1 steps don't send anything so don't ramp into or out of them
+  int16_t div=divtable[seq->divider];
+  int16_t elapsed=div-seq->clockticks;
+  return from+(int32_t)(to-from)*elapsed/div;
+}
+
+// clock the mod sequencers and send CCs
+// the step values are always sent. with ramping on, the MIDI clocks in between send interpolated values
+// but only as many as fit in the bandwidth the notes left on each port - the serial port saturates long before USB
+// ramp points are handed out round robin so every track gets its share when a port can't take them all
+void __not_in_flash_func(domods)(uint32_t clockperiod, bool onmidiclock) {
+  int16_t ccval[NTRACKS]; // value to send this tick, -1 for nothing
+  bool stepped[NTRACKS];
   for (uint8_t track=0; track<NTRACKS;++track) {
+    stepped[track]=seqclock(&mods[track],track,MOD_LANE);  // true when sequencer steps
+    ccval[track]=-1;
+    if (!bitRead(mod_enabled,track)) continue;
+    if (stepped[track]) ccval[track]=mods[track].val[mods[track].index]; // get the CC value to send
+    else if (onmidiclock && bitRead(mod_ramp,track)) ccval[track]=rampvalue(&mods[track]);
+  }
 
-    // a clock tick has expired so clock the sequencers
-    seqclock(&notes[track]);  // have to call by reference
-    seqclock(&offsets[track]);
-    seqclock(&velocities[track]);
-    seqclock(&probability[track]);
-    seqclock(&ratchets[track]);
-    gatestate=seqclock(&gates[track]);  
-
-    // check if gate became active and if so send note on
-    if (gatestate && notes[track].active[notes[track].index] && trackenabled[track] && (probability[track].val[probability[track].index] > random(PROBABILITYRANGE-1))) {
-      active_notelength[track]=clockperiod*gates[track].val[gates[track].index]*gates[track].divider/GATERANGE;     // calculate notelength is ms from gate length
-      if(ratchets[track].val[ratchets[track].index] >0) ratchetcnt[track]=(ratchets[track].val[ratchets[track].index]+1)*2-1; // for 1 ratchet the count is 3(noteon) 2 (noteoff) 1 (noteon) 0 (noteoff)
-      if ((active_notelength[track] > 0) && (ratchetcnt[track] > 0)) { // if we have ratchets divide up the notelength to the number of ratchets
-        active_notelength[track]=clockperiod*gates[track].divider/(ratchetcnt[track]+1); // for 1 ratchet (2 notes) divide the note time in four and send noteon/noteoff when the count changes ie 50% gate 
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    // step values first. CC value -1 means don't send anything. don't send same CC message over and over
+    for (uint8_t track=0; track<NTRACKS;++track) {
+      if (stepped[track] && (ccval[track] >=0) && (ccval[track]!=lastCC[port][track])) {
+        if (controlChangePort(port,((byte)CCchannel[track])-1,(byte)mods[track].root,(byte)ccval[track])) // in this case seq.root is the CC number
+          lastCC[port][track]=ccval[track];
       }
-      notetimer[track]=millis()+active_notelength[track];
-      if ((active_notelength[track] > 0) && (!tie[track])) {  // no note on when gate is zero or a tied note is in progress
-        active_note[track]=notes[track].val[notes[track].index]+offsets[track].val[offsets[track].index]*offsets[track].active[offsets[track].index]+notes[track].root;
-        active_note[track] = constrain(active_note[track],0,127); // limit to MIDI range
-        active_note[track]= quantize(active_note[track],scales[current_scale[track]],notes[track].root); // quantize to current root and scale
-        active_velocity[track]=constrain(velocities[track].val[velocities[track].index]*VELOCITYSCALE,0,127);
-        noteOn(MIDIchannel[track]-1,active_note[track],active_velocity[track]);
-        //Serial.printf("noteon %d\n",active_note);
+    }
+    // then ramp points in whatever bandwidth is left
+    int16_t budget=msgbudget(port_bytes_per_sec[port],clockperiod*CLOCKS_PER_MIDI_CLOCK,tickbytes[port]); // ramps get a MIDI clock's worth
+    uint8_t track=ramp_rr[port];
+    for (uint8_t i=0; (i<NTRACKS) && (budget > 0);++i) {
+      if (!stepped[track] && (ccval[track] >=0) && (ccval[track]!=lastCC[port][track])) {
+        if (controlChangePort(port,((byte)CCchannel[track])-1,(byte)mods[track].root,(byte)ccval[track]))
+          lastCC[port][track]=ccval[track];
+        --budget;
+        ramp_rr[port]=(track+1)%NTRACKS; // next tick starts after the last track served
       }
-      if ((gates[track].val[gates[track].index]==GATERANGE) && (ratchetcnt[track]==0)) tie[track]=TRUE; // 100% gate is a tied note, unless we are ratcheting
-      else tie[track]=FALSE;
-      //Serial.printf("notelength %d\n",notelength);
+      track=(track+1)%NTRACKS;
     }
+  }
+}
 
-    // process note offs and ratchets
-    // the code produces 50% gate time on ratchets
-    // this was hard to get right! maybe should be a state machine
+// index a lane will be on after ahead more clock ticks - ahead=0 is the current index
+// a lane that rolls over before then is assumed to move one step. random modes can't be predicted and stay put
+int16_t __not_in_flash_func(laneindex)(sequencer *seq, int16_t ahead) {
+  if ((ahead > 0) && (seq->clockticks <= ahead)) return nextindex(seq);
+  return seq->index;
+}
 
-    if (millis() > notetimer[track]) { // if note timer has expired
-      if (active_note[track] && (!tie[track])) {
-        if (ratchetcnt[track] >0) { // we are ratcheting
-          if (ratchetcnt[track] & 1) noteOff(MIDIchannel[track]-1,active_note[track],0); // ratcheting - note off on odd ratchet counts
-        }
-        else noteOff(MIDIchannel[track]-1,active_note[track],0); // not ratcheting, turn note off
-        if (ratchetcnt[track]==0) active_note[track]=0;  // its the last ratchet
-        else notetimer[track]=millis()+active_notelength[track]; // schedule another
-      }
-      if (ratchetcnt[track] && active_note[track]) {  // we are ratcheting so send another note on
-        if (!(ratchetcnt[track] &1)) noteOn(MIDIchannel[track]-1,active_note[track],active_velocity[track]); // send noteon every 2nd count
-        //Serial.printf("noteon %d\n",active_note);
-        if ((--ratchetcnt[track]) == 0) active_note[track]=0;
-      }     
+// timing offset of a step in us - the timing lane value plus swing on odd steps, limited to half a step either way
+int32_t __not_in_flash_func(stepoffset)(uint8_t track, int16_t gateindex, int16_t timingindex, uint32_t steplen) {
+  int32_t offset=(int32_t)timing[track].val[timingindex]*bitRead(timing[track].active,timingindex)*(int32_t)steplen/(2*TIMINGRANGE);
+  if (gateindex & 1) offset+=(int32_t)steplen*swing[track]/100;
+  return constrain(offset,-(int32_t)steplen/2,(int32_t)steplen/2);
+}
+
+// a track's output delay in us
+int32_t __not_in_flash_func(outputdelay_us)(uint8_t track) {
+  return (int32_t)outputdelay[track]*OUTPUTDELAY_US;
+}
+
+// queue a note event for a track. due is when it goes out, output delay and all
+// ticks are rendered ahead so most notes go out after the tick's CCs have been budgeted. they are counted against
+// the ports' bandwidth when they are rendered instead - a note rendered late gets counted again when it goes out,
+// which only leaves the CC ramps less room
+void __not_in_flash_func(pushnote)(uint8_t track, uint32_t due, uint8_t status, uint8_t pitch, uint8_t velocity) {
+  for (uint8_t port=0; port<NUM_PORTS;++port) tickbytes[port]+=MIDI_MSG_BYTES;
+  timedevent e;
+  e.due_us=due;
+  e.status=status | (MIDIchannel[track]-1);
+  e.pitch=pitch;
+  e.velocity=velocity;
+  e.track=track;
+  e.gen=notegen[track];
+  pushevent(&e);
+}
+
+void __not_in_flash_func(scheduleoff)(uint8_t track, uint8_t pitch, uint32_t due) {
+  pushnote(track,due,midi::NoteOff,pitch,0);
+  noteoff_due[track]=due;
+}
+
+// work out everything a gate step plays and queue it with us deadlines
+// ahead is how many ticks before the step we are rendering it - non zero for steps that play early
+// step_us is when the step is due on the grid, earliest is the earliest we can still send anything
+// the track's output delay is added to the step time here and nowhere else so the clock and lanes work in grid time
+// and everything the step queues, ties and cut offs included, is in the track's own output time
+// after this the output path only has to compare timestamps
+void __not_in_flash_func(renderstep)(uint8_t track, int16_t ahead, uint32_t step_us, uint32_t earliest, uint32_t tickperiod) {
+  if (nextroot[track] >= 0) { // transposed from a keyboard - the quantizer for the new key is already worked out
+    notes[track].root=nextroot[track];
+    quantsel[track]^=1;
+    nextroot[track]=-1;
+  }
+  int16_t gi=laneindex(&gates[track],ahead);
+  int16_t ni=laneindex(&notes[track],ahead);
+  int16_t oi=laneindex(&offsets[track],ahead);
+  int16_t vi=laneindex(&velocities[track],ahead);
+  int16_t pi=laneindex(&probability[track],ahead);
+  int16_t ri=laneindex(&ratchets[track],ahead);
+  int16_t ti=laneindex(&timing[track],ahead);
+
+  // step masks are ANDed - the gate step isn't muted and the probability step is on and in the euclidean rhythm
+  // a fill plays its gate steps whatever the mutes, euclidean rhythm and probability say. notes switched off never play
+  if (!(bitRead(notes[track].active,ni) && bitRead(trackenabled,track))) return;
+  bool on=bitRead(gates[track].active,gi) && bitRead(probability[track].active & eucmask[track],pi);
+  if (!bitRead(fillmask[track],gi) && !(on && ((rngat(track,PROBABILITY_LANE,songtick+ahead) | 1) <= probthreshold[probability[track].val[pi]]))) return;
+
+  uint32_t steplen=divtable[gates[track].divider]*tickperiod;
+  uint32_t on_us=step_us+stepoffset(track,gi,ti,steplen)+outputdelay_us(track);
+  if ((int32_t)(on_us-earliest) < 0) on_us=earliest; // too late to play it early - delay included, the note can't go out before now
+  uint32_t len=steplen*gates[track].val[gi]/GATERANGE;  // gate length is a fraction of the step
+  int16_t nratchets=ratchets[track].val[ri];
+  bool newtie=(gates[track].val[gi]==GATERANGE) && (nratchets==0); // 100% gate is a tied note, unless we are ratcheting
+
+  if (tie[track]) { // a tied note from an earlier step is still sounding - no new note, this step decides when it ends
+    tie[track]=newtie;
+    if (!newtie) scheduleoff(track,active_note[track],on_us+len); // zero gate ends it right away
+    return;
+  }
+  if (len == 0) return; // no note on when gate is zero
+
+  int16_t note=notes[track].val[ni]+offsets[track].val[oi]*bitRead(offsets[track].active,oi)+notes[track].root;
+  note=constrain(note,0,127); // limit to MIDI range
+  note=quantnote(track,note,notes[track].root); // quantize to current root and scale
+  int16_t velocity=constrain(velocities[track].val[vi]*VELOCITYSCALE,0,127);
+
+  if ((int32_t)(noteoff_due[track]-on_us) > 0) { // last note would still be on - cut it and drop whatever it had left
+    cut_us[track][notegen[track] % NOTEGENS]=on_us; // with render ahead it may not have started yet - that part still plays
+    ++notegen[track];
+    scheduleoff(track,active_note[track],on_us);
+  }
+  active_note[track]=note;
+  active_velocity[track]=velocity;
+  tie[track]=newtie;
+
+  if (nratchets > 0) { // the whole burst is queued now - the step splits into equal hits, each with its own gate and velocity
+    uint32_t hitlen=steplen/(nratchets+1)*ratchetgate[track]/100;
+    for (int16_t i=0; i<=nratchets;++i) {
+      uint32_t hit_us=on_us+steplen*i/(nratchets+1); // each hit from the step start so rounding doesn't add up over the burst
+      int16_t hitvelocity=velocity+(int32_t)velocity*ratchetramp[track]*i/(100*nratchets); // linear ramp over the burst
+      pushnote(track,hit_us,midi::NoteOn,note,constrain(hitvelocity,1,127));
+      scheduleoff(track,note,hit_us+hitlen);
+    }
+  }
+  else {
+    pushnote(track,on_us,midi::NoteOn,note,velocity);
+    if (!newtie) scheduleoff(track,note,on_us+len);
+  }
+}
+
+// send every note event that is due
+// events from notes that were cut short by a later one are dropped from the cut on
+// this is the output half of the pipeline - it only compares timestamps so it goes out on time however heavy rendering is
+void __not_in_flash_func(dispatchevents)(uint32_t now) {
+  timedevent e;
+  while (eventdue(now)) {
+    popevent(&e);
+    if ((e.gen != notegen[e.track]) && ((int32_t)(e.due_us-cut_us[e.track][e.gen % NOTEGENS]) >= 0)) continue;
+    emitlate_us=now-e.due_us;
+    if (emitlate_us > emitlate_max_us) emitlate_max_us=emitlate_us;
+    ++emitcount;
+    if ((e.status & 0xF0) == midi::NoteOn) noteOn(e.status & 0x0F,e.pitch,e.velocity);
+    else noteOff(e.status & 0x0F,e.pitch,0);
+  }
+}
+
+// core 1 - copy the playheads of the tracks that moved for the UI
+void __not_in_flash_func(publishplayheads)(void) {
+  if (!playheadsmoved) return;
+  playheadseq=playheadseq+1; // odd - a copy core 0 makes now won't be used
+  __sync_synchronize();
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if (!bitRead(playheadsmoved,track)) continue;
+    for (uint8_t lane=0; lane<NUM_LANES;++lane) playheads[track][lane]=getlane(track,lane)->index;
+  }
+  __sync_synchronize();
+  playheadseq=playheadseq+1;
+  playheadsmoved=0;
+}
+
+// core 0 - copy the playheads if they have moved since the copy made at *seen. returns true if they have
+bool readplayheads(int8_t copy[NTRACKS][NUM_LANES], uint32_t *seen) {
+  uint32_t count=playheadseq;
+  if (count == *seen) return false;
+  do {
+    while ((count=playheadseq) & 1); // core 1 is part way through - it only takes a few us
+    __sync_synchronize();
+    memcpy(copy,playheads,sizeof(playheads));
+    __sync_synchronize();
+  } while (playheadseq != count);
+  *seen=count;
+  return true;
+}
+
+// clock all the sequencers
+// clockperiod is the period of the internal PPQN clock in us - used for calculating gate times etc
+// tick_us is the tick's grid time. ticks are normally rendered ahead of it so its notes are queued before they are due
+// this code got a bit messy after I added multiple tracks
+// it loops thru all tracks clocking the lanes. when a gate lane steps the step is rendered into timed note events
+// steps with a negative timing offset are rendered on the last MIDI clock before they are due instead
+// cost is linear in NTRACKS - each track does a fixed amount of work per tick so keep it that way
+// the early step check and mod ramps only run once per MIDI clock so a tick between MIDI clocks is just the lane countdowns
+void __not_in_flash_func(clocktick)(uint32_t clockperiod, uint32_t tick_us) {
+  int16_t gatestate;
+  uint32_t t0=micros();
+  uint32_t now=t0; // nothing can go out before this
+  bool onmidiclock=(songtick%CLOCKS_PER_MIDI_CLOCK) == 0;
+  clearportbytes(); // start counting MIDI bandwidth for this tick
+  for (uint8_t track=0; track<NTRACKS;++track) {
+
+    // a clock tick has expired so clock the sequencers
+    seqclock(&notes[track],track,NOTE_LANE);  // have to call by reference
+    seqclock(&offsets[track],track,OFFSET_LANE);
+    seqclock(&velocities[track],track,VELOCITY_LANE);
+    seqclock(&probability[track],track,PROBABILITY_LANE);
+    seqclock(&ratchets[track],track,RATCHET_LANE);
+    seqclock(&timing[track],track,TIMING_LANE);
+    gatestate=seqclock(&gates[track],track,GATE_LANE);  
+
+    if (gatestate) { // gate stepped - render it unless it already went out early
+      if (prerendered[track]) prerendered[track]=FALSE;
+      else renderstep(track,0,tick_us,now,clockperiod);
     }
 
-    // process mod sequencers
-    gatestate=seqclock(&mods[track]); 
-    if (gatestate) { // true when sequencer steps
-      ccval=mods[track].val[mods[track].index]; // get the CC value to send
-      if ((mod_enabled[track]) && (ccval >=0) && (ccval!=lastCC[track])) { // CC value -1 means don't send anything. don't send same CC message over and over
-        controlChange(((byte)CCchannel[track])-1,(byte)mods[track].root,(byte)ccval); // in this case seq.root is the CC number
-        lastCC[track]=ccval;
-      }
+    // check if the next gate step plays early enough that this is the last MIDI clock before it
+    if (!onmidiclock) continue;
+    int16_t ahead=gates[track].clockticks;  // ticks till the next gate step
+    uint32_t steplen=divtable[gates[track].divider]*clockperiod;
+    int32_t offset=stepoffset(track,laneindex(&gates[track],ahead),laneindex(&timing[track],ahead),steplen);
+    if ((offset < 0) && ((int32_t)(ahead*clockperiod)+offset >= 0) && ((int32_t)((ahead-CLOCKS_PER_MIDI_CLOCK)*clockperiod)+offset < 0)) {
+      renderstep(track,ahead,tick_us+ahead*clockperiod,now,clockperiod);
+      prerendered[track]=TRUE;
     }
   }
+  dispatchevents(now); // anything already due goes out before the CCs
+  // mod sequencers go after all the notes so CCs never hold up a note on the slow serial port
+  // CCs aren't timed events so they go out when the tick is rendered - up to renderlead_us ahead of its notes
+  domods(clockperiod,onmidiclock);
+  flushmidi(); // send this tick's notes and as many CCs as the ports can take
+  publishplayheads();
+  ++songtick;
+  ticktime_us=micros()-t0;  // measure the cost of the tick so we can see how it scales with NTRACKS
+  if (ticktime_us > ticktime_max_us) ticktime_max_us=ticktime_us;
 }
  
 
+// menu handler for output delays - render far enough ahead that the track sent earliest still has the full lookahead
+// so an advance is served by rendering early rather than by holding the other tracks back
+void setrenderlead(void) {
+  int32_t advance=0;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if (-outputdelay_us(track) > advance) advance=-outputdelay_us(track);
+  }
+  renderlead_us=LOOKAHEAD_US+advance;
+}
+
+// period of the internal clock in us at the current BPM
+uint32_t __not_in_flash_func(clockperiod_us)(void) {
+  return (uint32_t)(((60.0/(float)bpm)/PPQN)*1000000);
+}
+
 // must be called regularly for sequencer to run
-void do_clocks(void) {
-  long clockperiod= (long)(((60.0/(float)bpm)/PPQN)*1000);
-  if ((millis() - clocktimer) > clockperiod) {
-    clocktimer=millis(); 
-    clocktick(clockperiod);
+// this is the render half of the pipeline. the next tick is rendered once it is within renderlead_us of its grid time
+// but not while a note is due before the render would finish - loop1() sends it first and we try again. once the
+// tick's grid time arrives it is rendered regardless. notes are sent by dispatchevents() from loop1()
+void __not_in_flash_func(do_clocks)(void) {
+  uint32_t clockperiod=clockperiod_us();
+  uint32_t now=micros();
+  uint32_t tick_us=clocktimer+clockperiod; // keep to the grid rather than drifting by however late we are
+  int32_t early=(int32_t)(tick_us-now);
+  if (early > (int32_t)renderlead_us) return;
+  if ((early > 0) && eventdue(now+ticktime_us+EMIT_MARGIN_US)) return;
+  if (early < -(int32_t)clockperiod) tick_us=now; // we fell way behind ie just started - don't try to catch up
+  clocktimer=tick_us;
+  clocktick(clockperiod,tick_us);
+}
+
+// external MIDI clock - each MIDI clock runs an internal tick straight away and the ticks between it and the next
+// MIDI clock are spread out at the BPM measured from the MIDI clock. if the next one comes early the leftovers run
+// first so we never fall behind the host
+// we can't render ahead of a MIDI clock we haven't had yet but the ticks in between are rendered ahead like do_clocks()
+// so on MIDI clock a track with an output advance only gets it on the ticks in between
+void __not_in_flash_func(midiclock)(void) {
+  uint32_t clockperiod=clockperiod_us();
+  uint32_t now=micros();
+  for (; midisubticks > 0;--midisubticks) clocktick(clockperiod,now);
+  clocktimer=now;
+  clocktick(clockperiod,now);
+  midisubticks=CLOCKS_PER_MIDI_CLOCK-1;
+}
+
+// must be called regularly when running on MIDI clock to fill in the ticks between MIDI clocks
+void __not_in_flash_func(do_midiclock)(void) {
+  uint32_t clockperiod=clockperiod_us();
+  uint32_t now=micros();
+  uint32_t tick_us=clocktimer+clockperiod;
+  int32_t early=(int32_t)(tick_us-now);
+  if ((midisubticks == 0) || (early > (int32_t)renderlead_us)) return;
+  if ((early > 0) && eventdue(now+ticktime_us+EMIT_MARGIN_US)) return;
+  clocktimer=tick_us;
+  --midisubticks;
+  clocktick(clockperiod,tick_us);
+}
+
+// note off for every note that is sounding on each port, and nothing else. returns the number sent
+uint16_t notesoff(void) {
+  uint16_t sent=0;
+  for (uint8_t port=0; port<NUM_PORTS;++port) {
+    for (uint8_t channel=0; channel<16;++channel) {
+      for (uint8_t word=0; word<4;++word) {
+        for (uint32_t bits=activenotes[port][channel][word]; bits; bits&=bits-1) { // the note off clears the real bit
+          if (noteOffPort(port,channel,word*32+__builtin_ctz(bits),0)) ++sent;
+        }
+      }
+    }
   }
+  return sent;
 }
 
 // send noteoff for all notes
+// everything still scheduled is dropped and only the notes the ports actually have sounding are turned off
+// so tied notes, notes cut short and notes whose off got lost all end without any redundant traffic
 void all_notes_off(void) {
+  clearevents();
   for (uint8_t track=0; track<NTRACKS;++track) {
-    noteOff(MIDIchannel[track]-1,active_note[track],0); // turn the note off
+    tie[track]=FALSE;
+    prerendered[track]=FALSE;
+    noteoff_due[track]=micros();
   }
+  notesoff();
+  flushmidi();
 }
 
-// resets all clock counters and indices to get everything back in sync
-void sync_sequencers(void){
-  for (int track=0; track<NTRACKS;++track) {
-    notes[track].clockticks=divtable[notes[track].divider];  // lookup table used to get clock divider
-    notes[track].index=0;
-    gates[track].clockticks=divtable[gates[track].divider];;
-    gates[track].index=0;
-    velocities[track].clockticks=divtable[velocities[track].divider];
-    velocities[track].index=0;
-    offsets[track].clockticks=divtable[offsets[track].divider];
-    offsets[track].index=0;
-    probability[track].clockticks=divtable[probability[track].divider];
-    probability[track].index=0;
-    ratchets[track].clockticks=divtable[ratchets[track].divider];
-    ratchets[track].index=0;
+// hung note detector - core 1 calls it while stopped. with nothing scheduled and no tied notes anything a port
+// still has sounding was missed, ie a note off lost to a full queue or to core 0 stopping us mid render
+// those notes are turned off and counted. much cheaper than sending CC 123 on every channel
+// keys held down on a keyboard that is being played thru are sounding on purpose so nothing is hung while there are any
+SEQ_STATE uint32_t heldkeys[4]; // one bit per note number
+
+void __not_in_flash_func(holdkey)(uint8_t pitch, bool held) {
+  if (held) heldkeys[pitch >> 5]|=1UL << (pitch & 31);
+  else heldkeys[pitch >> 5]&=~(1UL << (pitch & 31));
+}
+
+void findhung(void) {
+  if (eventcount || heldkeys[0] || heldkeys[1] || heldkeys[2] || heldkeys[3]) return;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    if (tie[track]) return;
   }
+  hungnotes+=notesoff();
+}
+
+// jump every lane to a song position in clock ticks - the next clock tick plays that position
+// lanes are left where they were on the tick before so a random walk takes its next step from there like it would
+// if it had played up to here
+void seek_sequencers(uint32_t tick) {
+  songtick=tick;
+  for (uint8_t track=0; track<NTRACKS;++track) {
+    for (uint8_t lane=0; lane<NUM_LANES;++lane) {
+      sequencer *seq=getlane(track,lane);
+      seqseek(seq,track,lane,tick ? tick-1 : 0);
+      if (tick == 0) seq->clockticks=1; // the first tick plays step 0
+    }
+    prerendered[track]=FALSE;
+  }
+  midisubticks=0;
+  playheadsmoved=(1 << NTRACKS)-1;
+  publishplayheads();
+}
+
+// back to the start of the song - all lanes including the mods start again on their first step
+void sync_sequencers(void){
+  for (uint8_t track=0; track<NTRACKS;++track) rngseed(track,seeds[track]); // in case the seed was changed
+  seek_sequencers(0);
 }
 
 // Euclidean calculation functions from http://clsound.com/euclideansequenc.html
@@ -775,18 +787,32 @@ uint16_t euclid(int n, int k, int o) { // inputs: n=total, k=beats, o = offset
 
 // menu function handler for euclidean probability
 // when you change the euclidean length, beats or offset this function is called
-// it sets the probability to 100% or 0% based on the euclidean pattern
-// effectively the same as turning on and off the gates 
+// it builds a step mask from the euclidean pattern that is ANDed with the probability steps when a step plays
+// effectively the same as turning on and off the gates but the probabilities you edited are left alone
 // you can also edit the probabilities for even more variation
 
-void eucprobability(void) {
-  uint16_t pattern;
-  pattern = euclid(probability[current_track].euclen,probability[current_track].eucbeats,probability[current_track].root); // "root" is used for offset in this case
-  rp2040.idleOtherCore(); // stop core 1 while we modify sequencer values
-  probability[current_track].last=probability[current_track].euclen-1; // reset the sequence length to the euclidean length set in the menus
-  for (int i=0;i<probability[current_track].euclen;++i){  // pattern is MSB first
-    if (bitRead(pattern,probability[current_track].euclen-i-1)) probability[current_track].val[i]=PROBABILITYRANGE; // 100% probability
-    else probability[current_track].val[i]=0;  // 0% probability, same as gate off
+
+// set a track's euclidean mask from its euclidean length, beats and offset
+// the mask and the lane length are single stores so core 1 keeps running
+void applyeuclid(uint8_t track) {
+  uint16_t pattern,mask;
+  int8_t len=probability[track].euclen;
+  pattern = euclid(len,probability[track].eucbeats,probability[track].root); // "root" is used for offset in this case
+  mask=ALL_STEPS << len; // steps past the pattern play if the lane is made longer again
+  for (int i=0;i<len;++i){  // pattern is MSB first
+    if (bitRead(pattern,len-i-1)) bitSet(mask,i);
   }
-  rp2040.resumeOtherCore();
+  eucmask[track]=mask;
+  probability[track].last=len-1; // reset the sequence length to the euclidean length set in the menus
+}
+
+void eucprobability(void) {
+  applyeuclid(current_track);
+}
+
+// menu function handler for fills - steps that play while the fill is on
+const uint16_t fillpatterns[] = {0,ALL_STEPS,0x5555,0xAAAA}; // off, every step, odd steps, even steps
+
+void setfill(void) {
+  fillmask[current_track]=fillpatterns[fillmode[current_track]];
 }
@@ -0,0 +1,308 @@
+// SysEx bulk dump and restore of every lane of every track and the menu settings
+// a dump is never built in RAM - its bytes are read straight out of the sequencer arrays and settings through a
+// table of regions, a chunk at a time. each chunk is its own SysEx message with its number and a CRC so a restore
+// can tell when one is missing or damaged. a restore is put together in a buffer and only goes live once every
+// chunk has checked out and every value has been brought into the range its menu or editor allows - a bad restore
+// leaves the sequencer as it was
+// lanes are dumped whole except for their play position which is worked out from the song position after a restore
+// so the same patterns always make the same dump
+//
+// messages are F0 7D 50 <type> ... F7 - 7D is the non commercial manufacturer id, 50 is P for Pico sequencer
+//   request  F0 7D 50 00 F7                             send a dump over USB
+//   header   F0 7D 50 01 <version> <tracks> <size x3> F7  size in bytes, 7 bits per byte low first
+//   chunk    F0 7D 50 02 <chunk x2> <data> <crc x3> F7    data is 7 bit packed - a byte of high bits then up to 7 bytes
+// the CRC is CRC-16/CCITT of the chunk number (2 bytes low first) and the unpacked data
+// a chunk message is kept under the MIDI library's 128 byte SysEx limit
+
+#define SYSEX_ID 0x7D
+#define SYSEX_DEVICE 0x50
+#define SYSEX_VERSION 2  // 2 - output delays in 0.1 ms
+enum SYSEXTYPES {SYSEX_REQUEST,SYSEX_HEADER,SYSEX_CHUNK};
+
+#define DUMP_CHUNK_BYTES 98  // 14 groups of 7 so a chunk is 112 packed bytes and 122 with the framing
+#define DUMP_MSG_MAX (6+DUMP_CHUNK_BYTES+DUMP_CHUNK_BYTES/7+4)
+
+struct dumpregion {
+  void *data;
+  uint16_t size;
+  bool lanes;  // an array of sequencers - their play positions are skipped
+  int8_t lo,hi;  // lanes - range of a step value, what the step editors allow
+};
+
+// add new settings at the end and bump SYSEX_VERSION. settings are clamped by the menus that set them
+constexpr dumpregion dumpregions[] = {
+  {notes,sizeof(notes),true,-NOTERANGE,NOTERANGE},
+  {offsets,sizeof(offsets),true,-NOTERANGE,NOTERANGE},
+  {gates,sizeof(gates),true,0,GATERANGE},
+  {velocities,sizeof(velocities),true,0,VELOCITYRANGE},
+  {probability,sizeof(probability),true,0,PROBABILITYRANGE},
+  {ratchets,sizeof(ratchets),true,0,RATCHETRANGE},
+  {timing,sizeof(timing),true,-TIMINGRANGE,TIMINGRANGE},
+  {mods,sizeof(mods),true,-1,MODRANGE},  // -1 is don't send
+  {MIDIchannel,sizeof(MIDIchannel),false,0,0},
+  {CCchannel,sizeof(CCchannel),false,0,0},
+  {&trackenabled,sizeof(trackenabled),false,0,0},
+  {&mod_enabled,sizeof(mod_enabled),false,0,0},
+  {&mod_ramp,sizeof(mod_ramp),false,0,0},
+  {current_scale,sizeof(current_scale),false,0,0},
+  {swing,sizeof(swing),false,0,0},
+  {ratchetgate,sizeof(ratchetgate),false,0,0},
+  {ratchetramp,sizeof(ratchetramp),false,0,0},
+  {seeds,sizeof(seeds),false,0,0},
+  {eucmask,sizeof(eucmask),false,0,0},
+  {fillmask,sizeof(fillmask),false,0,0},
+  {fillmode,sizeof(fillmode),false,0,0},
+  {outputdelay,sizeof(outputdelay),false,0,0},
+  {&bpm,sizeof(bpm),false,0,0},
+  {&useMIDIclock,sizeof(useMIDIclock),false,0,0},
+  {transposechan,sizeof(transposechan),false,0,0},
+  {thrudest,sizeof(thrudest),false,0,0},
+  {thruchannel,sizeof(thruchannel),false,0,0},
+};
+#define NUM_DUMPREGIONS (sizeof(dumpregions)/sizeof(dumpregion))
+
+volatile bool dumprequested; // core 0 asks core 1 to start a dump
+volatile bool restoredone; // core 1 has restored a whole dump - core 0 redraws
+int16_t dumpnext=-1; // next dump message core 1 sends - 0 is the header, -1 for none
+int16_t restorenext=-1; // next chunk a restore expects, -1 for none
+uint32_t sysexerrors; // restores abandoned - bad CRC, missing chunk or a dump from a different build
+uint32_t dumpssent,restoresdone; // whole dumps sent and restored
+
+constexpr uint32_t dumpsize(void) {
+  uint32_t size=0;
+  for (uint8_t r=0; r<NUM_DUMPREGIONS;++r) size+=dumpregions[r].size;
+  return size;
+}
+
+uint8_t restorebuf[dumpsize()]; // a restore is put together here
+
+uint16_t dumpchunks(void) {
+  return (dumpsize()+DUMP_CHUNK_BYTES-1)/DUMP_CHUNK_BYTES;
+}
+
+// bytes in a chunk - the last one is short
+uint16_t chunkbytes(uint16_t chunk) {
+  uint32_t left=dumpsize()-(uint32_t)chunk*DUMP_CHUNK_BYTES;
+  return (left < DUMP_CHUNK_BYTES) ? left : DUMP_CHUNK_BYTES;
+}
+
+// true for the bytes of a lane that are its play position rather than its pattern
+bool playbyte(uint16_t offset) {
+  offset%=sizeof(sequencer);
+  return (offset == offsetof(sequencer,index)) || (offset == offsetof(sequencer,state)) ||
+    ((offset >= offsetof(sequencer,clockticks)) && (offset < offsetof(sequencer,clockticks)+sizeof(int16_t)));
+}
+
+// copy n bytes at offset in the dump to or from buf. play position bytes read as 0 and aren't written
+void dumpcopy(uint32_t offset, uint8_t *buf, uint16_t n, bool restore) {
+  uint8_t r=0;
+  while ((r < NUM_DUMPREGIONS) && (offset >= dumpregions[r].size)) offset-=dumpregions[r++].size;
+  for (; (r < NUM_DUMPREGIONS) && n; ++r, offset=0) {
+    uint8_t *data=(uint8_t *)dumpregions[r].data;
+    for (; (offset < dumpregions[r].size) && n; ++offset, --n, ++buf) {
+      bool skip=dumpregions[r].lanes && playbyte(offset);
+      if (restore) {
+        if (!skip) data[offset]=*buf;
+      }
+      else *buf=skip ? 0 : data[offset];
+    }
+  }
+}
+
+uint16_t crc16(uint16_t crc, const uint8_t *buf, uint16_t n) {
+  while (n--) {
+    crc^=(uint16_t)*buf++ << 8;
+    for (uint8_t i=0; i<8;++i) crc=(crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint16_t chunkcrc(uint16_t chunk, const uint8_t *data, uint16_t n) {
+  uint8_t number[2]={(uint8_t)chunk,(uint8_t)(chunk >> 8)};
+  return crc16(crc16(0xFFFF,number,2),data,n);
+}
+
+// 8 bit data to 7 bit - returns the packed length
+uint16_t pack7(const uint8_t *in, uint16_t n, uint8_t *out) {
+  uint16_t len=0;
+  for (uint16_t i=0; i<n; i+=7) {
+    uint8_t *high=&out[len++];
+    *high=0;
+    for (uint8_t j=0; (j<7) && (i+j<n);++j) {
+      if (in[i+j] & 0x80) *high|=1 << j;
+      out[len++]=in[i+j] & 0x7F;
+    }
+  }
+  return len;
+}
+
+// and back - returns the unpacked length
+uint16_t unpack7(const uint8_t *in, uint16_t n, uint8_t *out) {
+  uint16_t len=0;
+  for (uint16_t i=0; i<n; i+=8) {
+    uint8_t high=in[i];
+    for (uint8_t j=0; (j<7) && (i+1+j<n);++j) out[len++]=in[i+1+j] | (((high >> j) & 1) << 7);
+  }
+  return len;
+}
+
+// build dump message n into msg - 0 is the header, then the chunks. returns its length, 0 past the end
+uint16_t dumpmessage(int16_t n, uint8_t *msg) {
+  uint32_t size=dumpsize();
+  uint16_t len=0;
+  msg[len++]=midi::SystemExclusive;
+  msg[len++]=SYSEX_ID;
+  msg[len++]=SYSEX_DEVICE;
+  if (n == 0) {
+    msg[len++]=SYSEX_HEADER;
+    msg[len++]=SYSEX_VERSION;
+    msg[len++]=NTRACKS;
+    for (uint8_t i=0; i<3;++i) msg[len++]=(size >> (7*i)) & 0x7F;
+  }
+  else {
+    uint16_t chunk=n-1;
+    if (chunk >= dumpchunks()) return 0;
+    uint16_t bytes=chunkbytes(chunk);
+    uint8_t data[DUMP_CHUNK_BYTES];
+    dumpcopy((uint32_t)chunk*DUMP_CHUNK_BYTES,data,bytes,false);
+    msg[len++]=SYSEX_CHUNK;
+    msg[len++]=chunk & 0x7F;
+    msg[len++]=chunk >> 7;
+    len+=pack7(data,bytes,&msg[len]);
+    uint16_t crc=chunkcrc(chunk,data,bytes);
+    for (uint8_t i=0; i<3;++i) msg[len++]=(crc >> (7*i)) & 0x7F;
+  }
+  msg[len++]=midi::SystemExclusiveEnd;
+  return len;
+}
+
+// where a dumped setting or lane lives in the restore buffer, 0 if it isn't dumped
+uint8_t *staged(const void *parameter) {
+  uint32_t offset=0;
+  for (uint8_t r=0; r<NUM_DUMPREGIONS;++r) {
+    const uint8_t *data=(const uint8_t *)dumpregions[r].data;
+    if ((parameter >= data) && (parameter < data+dumpregions[r].size)) return &restorebuf[offset+((const uint8_t *)parameter-data)];
+    offset+=dumpregions[r].size;
+  }
+  return 0;
+}
+
+// bring a restore into the ranges the UI allows before it goes live, so a dump from a different build or edited
+// by hand can't put the sequencer anywhere the UI couldn't. the buffer isn't aligned like the real thing so
+// everything is copied in and out
+void restoreclamp(void) {
+  uint32_t offset=0;
+  for (uint8_t r=0; r<NUM_DUMPREGIONS;++r) { // step values and the loop points the step editors set
+    for (uint16_t i=0; dumpregions[r].lanes && (i < dumpregions[r].size); i+=sizeof(sequencer)) {
+      sequencer seq;
+      memcpy(&seq,&restorebuf[offset+i],sizeof(seq));
+      for (uint8_t step=0; step<SEQ_STEPS;++step) seq.val[step]=constrain(seq.val[step],dumpregions[r].lo,dumpregions[r].hi);
+      seq.max=dumpregions[r].hi;
+      seq.first=constrain(seq.first,0,SEQ_STEPS-1);
+      seq.last=constrain(seq.last,seq.first,SEQ_STEPS-1);
+      memcpy(&restorebuf[offset+i],&seq,sizeof(seq));
+    }
+    offset+=dumpregions[r].size;
+  }
+  for (uint16_t m=0; m<NUM_MAIN_MENUS;++m) { // everything a menu sets - rates, step modes, channels, scales, delays..
+    for (int8_t s=0; s<mainmenu[m].numsubmenus;++s) {
+      const submenu *sub=&mainmenu[m].submenus[s];
+      uint8_t *p=staged(sub->parameter);
+      if (!p || (sub->binding == BIND_BIT) || (sub->binding == BIND_NONE)) continue; // any bit is a valid flag
+      if (sub->binding == BIND_INT16) {
+        int16_t val;
+        memcpy(&val,p,sizeof(val));
+        val=constrain(val,sub->min,sub->max);
+        memcpy(p,&val,sizeof(val));
+      }
+      else if (sub->binding == BIND_INT8) *p=(uint8_t)constrain((int8_t)*p,sub->min,sub->max);
+      else *p=constrain(*p,sub->min,sub->max);
+    }
+  }
+}
+
+// everything worked out from the settings rather than dumped - core 1 after the last chunk
+void restorefixup(void) {
+  for (uint8_t track=0; track<NTRACKS;++track) rngseed(track,seeds[track]);
+  setrenderlead();
+  setthru();
+  settranspose();
+  seek_sequencers(songtick); // play positions for the new patterns
+}
+
+// take one restore message. returns false if it wasn't one of ours or was rejected
+bool restoremessage(const uint8_t *msg, uint16_t len) {
+  if ((len < 5) || (msg[0] != midi::SystemExclusive) || (msg[1] != SYSEX_ID) || (msg[2] != SYSEX_DEVICE) || (msg[len-1] != midi::SystemExclusiveEnd)) return false;
+  uint32_t size=dumpsize();
+  if (msg[3] == SYSEX_HEADER) {
+    restorenext=-1;
+    if ((len != 10) || (msg[4] != SYSEX_VERSION) || (msg[5] != NTRACKS) || ((msg[6] | (msg[7] << 7) | ((uint32_t)msg[8] << 14)) != size)) {
+      ++sysexerrors;
+      return false;
+    }
+    restorenext=0;
+    return true;
+  }
+  if ((msg[3] != SYSEX_CHUNK) || (restorenext < 0)) return false;
+  bool fits=(len > 10) && (len <= DUMP_MSG_MAX); // room for some data and no more than a chunk
+  uint16_t chunk=fits ? msg[4] | (msg[5] << 7) : 0xFFFF;
+  uint8_t data[DUMP_CHUNK_BYTES];
+  uint16_t bytes=fits ? unpack7(&msg[6],len-10,data) : 0;
+  uint16_t crc=fits ? msg[len-4] | (msg[len-3] << 7) | (msg[len-2] << 14) : 0;
+  if ((chunk != restorenext) || (bytes != chunkbytes(chunk)) || (crc != chunkcrc(chunk,data,bytes))) {
+    restorenext=-1;
+    ++sysexerrors;
+    return false;
+  }
+  memcpy(&restorebuf[(uint32_t)chunk*DUMP_CHUNK_BYTES],data,bytes);
+  if (++restorenext == dumpchunks()) { // all there - only now does anything change
+    restorenext=-1;
+    restoreclamp();
+    dumpcopy(0,restorebuf,dumpsize(),true);
+    restorefixup();
+    ++restoresdone;
+    restoredone=true;
+  }
+  return true;
+}
+
+// menu action - turning the encoder sends a dump
+void startdump(void) {
+  dumprequested=true;
+}
+
+// core 1 - SysEx from either port. a request is answered on USB, the only port fast enough for a dump
+void handleSysEx(byte *data, unsigned size) {
+  if ((size == 5) && (data[1] == SYSEX_ID) && (data[2] == SYSEX_DEVICE) && (data[3] == SYSEX_REQUEST)) dumprequested=true;
+  else restoremessage(data,size);
+}
+
+// core 1 - send the next dump message if the USB port has time for it
+// a message only goes out once everything queued ahead of it has drained and no note is due while it is on the
+// wire, and it is counted in the port's drain estimate so the scheduler holds sequencer output behind it. the
+// sequencer never waits more than one message's airtime - about 2.5 ms - and an idle port sends back to back
+void __not_in_flash_func(sysexpump)(void) {
+  if (dumprequested) {
+    dumprequested=false;
+    dumpnext=0; // a request during a dump starts it again
+  }
+  if (dumpnext < 0) return;
+  if (!portenabled(PORT_USB)) {
+    dumpnext=-1;
+    return;
+  }
+  uint32_t now=micros();
+  if (portbacklog(PORT_USB,now) > 0) return;
+  uint8_t msg[DUMP_MSG_MAX];
+  uint16_t len=dumpmessage(dumpnext,msg);
+  if (len == 0) {
+    dumpnext=-1;
+    ++dumpssent;
+    return;
+  }
+  uint32_t airtime=len*port_us_per_byte[PORT_USB];
+  if (eventdue(now+airtime)) return;
+  MidiUSB.sendSysEx(len,msg,true);
+  port_busy_until[PORT_USB]=now+airtime;
+  ++dumpnext;
+}
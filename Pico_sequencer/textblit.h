@@ -0,0 +1,154 @@
+// fast text for the menus and page headers
+// Adafruit_GFX draws the 6x8 font through drawPixel() one pixel at a time - 48 calls per character, each with its own
+// rotation and clipping maths. here the font is packed once into 6 column bytes per character in the panel's own
+// orientation and a character is written straight into the SSD1306 page buffer, with a shift and mask when it isn't
+// on an 8 pixel boundary. text is always opaque ie setTextColor(WHITE,BLACK) which is all the sequencer uses
+// blitf() is a cut down printf for %d %s %c and %% with width and 0 padding - no heap, no floats, no sprintf
+
+#define GLYPH_FIRST ' '
+#define GLYPH_LAST '~'
+#define GLYPH_COUNT (GLYPH_LAST-GLYPH_FIRST+1)
+#define GLYPH_WIDTH 6  // 5 font columns and a blank one between characters
+#define GLYPH_HEIGHT 8
+
+// classic Adafruit 5x7 font, one byte per column, LSB at the top. printable ASCII only
+const uint8_t glyphfont[GLYPH_COUNT][5] = {
+  {0x00,0x00,0x00,0x00,0x00},{0x00,0x00,0x5F,0x00,0x00},{0x00,0x07,0x00,0x07,0x00},{0x14,0x7F,0x14,0x7F,0x14}, //  !"#
+  {0x24,0x2A,0x7F,0x2A,0x12},{0x23,0x13,0x08,0x64,0x62},{0x36,0x49,0x55,0x22,0x50},{0x00,0x05,0x03,0x00,0x00}, // $%&'
+  {0x00,0x1C,0x22,0x41,0x00},{0x00,0x41,0x22,0x1C,0x00},{0x08,0x2A,0x1C,0x2A,0x08},{0x08,0x08,0x3E,0x08,0x08}, // ()*+
+  {0x00,0x50,0x30,0x00,0x00},{0x08,0x08,0x08,0x08,0x08},{0x00,0x60,0x60,0x00,0x00},{0x20,0x10,0x08,0x04,0x02}, // ,-./
+  {0x3E,0x51,0x49,0x45,0x3E},{0x00,0x42,0x7F,0x40,0x00},{0x42,0x61,0x51,0x49,0x46},{0x21,0x41,0x45,0x4B,0x31}, // 0123
+  {0x18,0x14,0x12,0x7F,0x10},{0x27,0x45,0x45,0x45,0x39},{0x3C,0x4A,0x49,0x49,0x30},{0x01,0x71,0x09,0x05,0x03}, // 4567
+  {0x36,0x49,0x49,0x49,0x36},{0x06,0x49,0x49,0x29,0x1E},{0x00,0x36,0x36,0x00,0x00},{0x00,0x56,0x36,0x00,0x00}, // 89:;
+  {0x08,0x14,0x22,0x41,0x00},{0x14,0x14,0x14,0x14,0x14},{0x00,0x41,0x22,0x14,0x08},{0x02,0x01,0x51,0x09,0x06}, // <=>?
+  {0x32,0x49,0x79,0x41,0x3E},{0x7E,0x11,0x11,0x11,0x7E},{0x7F,0x49,0x49,0x49,0x36},{0x3E,0x41,0x41,0x41,0x22}, // @ABC
+  {0x7F,0x41,0x41,0x22,0x1C},{0x7F,0x49,0x49,0x49,0x41},{0x7F,0x09,0x09,0x01,0x01},{0x3E,0x41,0x41,0x51,0x32}, // DEFG
+  {0x7F,0x08,0x08,0x08,0x7F},{0x00,0x41,0x7F,0x41,0x00},{0x20,0x40,0x41,0x3F,0x01},{0x7F,0x08,0x14,0x22,0x41}, // HIJK
+  {0x7F,0x40,0x40,0x40,0x40},{0x7F,0x02,0x04,0x02,0x7F},{0x7F,0x04,0x08,0x10,0x7F},{0x3E,0x41,0x41,0x41,0x3E}, // LMNO
+  {0x7F,0x09,0x09,0x09,0x06},{0x3E,0x41,0x51,0x21,0x5E},{0x7F,0x09,0x19,0x29,0x46},{0x46,0x49,0x49,0x49,0x31}, // PQRS
+  {0x01,0x01,0x7F,0x01,0x01},{0x3F,0x40,0x40,0x40,0x3F},{0x1F,0x20,0x40,0x20,0x1F},{0x7F,0x20,0x18,0x20,0x7F}, // TUVW
+  {0x63,0x14,0x08,0x14,0x63},{0x03,0x04,0x78,0x04,0x03},{0x61,0x51,0x49,0x45,0x43},{0x00,0x7F,0x41,0x41,0x00}, // XYZ[
+  {0x02,0x04,0x08,0x10,0x20},{0x00,0x41,0x41,0x7F,0x00},{0x04,0x02,0x01,0x02,0x04},{0x40,0x40,0x40,0x40,0x40}, // \]^_
+  {0x00,0x01,0x02,0x04,0x00},{0x20,0x54,0x54,0x54,0x78},{0x7F,0x48,0x44,0x44,0x38},{0x38,0x44,0x44,0x44,0x20}, // `abc
+  {0x38,0x44,0x44,0x48,0x7F},{0x38,0x54,0x54,0x54,0x18},{0x08,0x7E,0x09,0x01,0x02},{0x08,0x14,0x54,0x54,0x3C}, // defg
+  {0x7F,0x08,0x04,0x04,0x78},{0x00,0x44,0x7D,0x40,0x00},{0x20,0x40,0x44,0x3D,0x00},{0x00,0x7F,0x10,0x28,0x44}, // hijk
+  {0x00,0x41,0x7F,0x40,0x00},{0x7C,0x04,0x18,0x04,0x78},{0x7C,0x08,0x04,0x04,0x78},{0x38,0x44,0x44,0x44,0x38}, // lmno
+  {0x7C,0x14,0x14,0x14,0x08},{0x08,0x14,0x14,0x18,0x7C},{0x7C,0x08,0x04,0x04,0x08},{0x48,0x54,0x54,0x54,0x20}, // pqrs
+  {0x04,0x3F,0x44,0x40,0x20},{0x3C,0x40,0x40,0x20,0x7C},{0x1C,0x20,0x40,0x20,0x1C},{0x3C,0x40,0x30,0x40,0x3C}, // tuvw
+  {0x44,0x28,0x10,0x28,0x44},{0x0C,0x50,0x50,0x50,0x3C},{0x44,0x64,0x54,0x4C,0x44},{0x00,0x08,0x36,0x41,0x00}, // xyz{
+  {0x00,0x00,0x7F,0x00,0x00},{0x00,0x41,0x36,0x08,0x00},{0x08,0x04,0x08,0x10,0x08}                           // |}~
+};
+
+uint8_t glyphs[GLYPH_COUNT][GLYPH_WIDTH]; // font columns in display buffer order for glyphrotation
+int8_t glyphrotation=-1; // display rotation the glyphs are packed for, -1 till they are packed
+
+uint8_t reversebits(uint8_t b) {
+  b=(b >> 4) | (b << 4);
+  b=((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+  return ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+}
+
+// pack the font for a display rotation. upside down reverses the columns and flips each one top to bottom
+void packglyphs(uint8_t rotation) {
+  for (uint8_t c=0; c<GLYPH_COUNT;++c) {
+    for (uint8_t i=0; i<GLYPH_WIDTH;++i) {
+      uint8_t column=(i < 5) ? glyphfont[c][i] : 0;
+      if (rotation == 2) glyphs[c][GLYPH_WIDTH-1-i]=reversebits(column);
+      else glyphs[c][i]=column;
+    }
+  }
+  glyphrotation=rotation;
+}
+
+// draw a character with its top left corner at x,y in screen coordinates. returns the x of the next character
+int16_t blitchar(int16_t x, int16_t y, char c) {
+  uint8_t rotation=display.getRotation();
+  if (rotation & 1) { // portrait - columns don't line up with the buffer bytes so let GFX do it
+    display.setCursor(x,y);
+    display.write(c);
+    return x+GLYPH_WIDTH;
+  }
+  if (rotation != glyphrotation) packglyphs(rotation);
+  if ((c < GLYPH_FIRST) || (c > GLYPH_LAST)) c='?';
+  const uint8_t *glyph=glyphs[c-GLYPH_FIRST];
+  int16_t bx=x, by=y; // top left of the character cell in the buffer
+  if (rotation == 2) {
+    bx=SCREEN_WIDTH-GLYPH_WIDTH-x;
+    by=SCREEN_HEIGHT-GLYPH_HEIGHT-y;
+  }
+  uint8_t *buf=display.getBuffer();
+  int16_t page=by >> 3;
+  uint8_t shift=by & 7;
+  for (uint8_t i=0; i<GLYPH_WIDTH;++i) {
+    int16_t column=bx+i;
+    if ((column < 0) || (column >= SCREEN_WIDTH)) continue;
+    if ((page >= 0) && (page < SCREEN_HEIGHT/8)) {
+      uint8_t *b=&buf[page*SCREEN_WIDTH+column];
+      *b=(*b & ~(0xFF << shift)) | (glyph[i] << shift);
+    }
+    if (shift && (page+1 >= 0) && (page+1 < SCREEN_HEIGHT/8)) { // the bottom of the cell is in the next page
+      uint8_t *b=&buf[(page+1)*SCREEN_WIDTH+column];
+      *b=(*b & ~(0xFF >> (8-shift))) | (glyph[i] >> (8-shift));
+    }
+  }
+  return x+GLYPH_WIDTH;
+}
+
+// returns the x after the text
+int16_t blittext(int16_t x, int16_t y, const char *text) {
+  while (*text) x=blitchar(x,y,*text++);
+  return x;
+}
+
+// blank from x to the end of the line
+void blittoend(int16_t x, int16_t y) {
+  while (x < SCREEN_WIDTH) x=blitchar(x,y,' ');
+}
+
+// integer to decimal text, built backwards from the end of the caller's buffer - 12 chars is enough for any int32
+// returns the start of the text
+char * fmtint(char *end, int32_t val) {
+  uint32_t u=(val < 0) ? -(uint32_t)val : val;
+  *--end=0;
+  do {
+    *--end='0'+u%10;
+    u/=10;
+  } while (u);
+  if (val < 0) *--end='-';
+  return end;
+}
+
+// printf style text at x,y. returns the x after the text
+int16_t blitf(int16_t x, int16_t y, const char *format, ...) {
+  va_list args;
+  char number[12];
+  char single[2]={0,0};
+  va_start(args,format);
+  for (const char *f=format; *f;++f) {
+    if (*f != '%') {
+      x=blitchar(x,y,*f);
+      continue;
+    }
+    char pad=' ';
+    uint8_t width=0;
+    if (*++f == '0') {
+      pad='0';
+      ++f;
+    }
+    while ((*f >= '0') && (*f <= '9')) width=width*10+*f++-'0';
+    const char *text;
+    switch (*f) {
+      case 'd': text=fmtint(number+sizeof(number),va_arg(args,int)); break;
+      case 's': text=va_arg(args,const char *); break;
+      case 'c': single[0]=va_arg(args,int); text=single; break;
+      case '%': text="%"; break;
+      default: va_end(args); return x; // not supported - stop rather than read the wrong arguments
+    }
+    uint8_t len=strlen(text);
+    if ((pad == '0') && (*text == '-')) x=blitchar(x,y,*text++); // sign goes before the zeros
+    for (; len<width;++len) x=blitchar(x,y,pad);
+    x=blittext(x,y,text);
+  }
+  va_end(args);
+  return x;
+}
@@ -0,0 +1,33 @@
+// compile time expansion of per track tables
+// NTRACKS must be a plain decimal number 1-16 for the token pasting below to work
+// FOR_EACH_TRACK(X) expands X(track,number) once per track - track is 0 based, number is 1 based for display text
+// this lets the sequencer data and menu tables be generated by the compiler instead of being copied and pasted per track
+
+#if (NTRACKS < 1) || (NTRACKS > 16)
+#error "NTRACKS must be 1-16"
+#endif
+
+#define TRACKS_1(X)  X(0,1)
+#define TRACKS_2(X)  TRACKS_1(X)  X(1,2)
+#define TRACKS_3(X)  TRACKS_2(X)  X(2,3)
+#define TRACKS_4(X)  TRACKS_3(X)  X(3,4)
+#define TRACKS_5(X)  TRACKS_4(X)  X(4,5)
+#define TRACKS_6(X)  TRACKS_5(X)  X(5,6)
+#define TRACKS_7(X)  TRACKS_6(X)  X(6,7)
+#define TRACKS_8(X)  TRACKS_7(X)  X(7,8)
+#define TRACKS_9(X)  TRACKS_8(X)  X(8,9)
+#define TRACKS_10(X) TRACKS_9(X)  X(9,10)
+#define TRACKS_11(X) TRACKS_10(X) X(10,11)
+#define TRACKS_12(X) TRACKS_11(X) X(11,12)
+#define TRACKS_13(X) TRACKS_12(X) X(12,13)
+#define TRACKS_14(X) TRACKS_13(X) X(13,14)
+#define TRACKS_15(X) TRACKS_14(X) X(14,15)
+#define TRACKS_16(X) TRACKS_15(X) X(15,16)
+
+#define TRACKS__(n,X) TRACKS_##n(X)
+#define TRACKS_(n,X) TRACKS__(n,X)   // extra level so NTRACKS gets expanded before pasting
+#define FOR_EACH_TRACK(X) TRACKS_(NTRACKS,X)
+
+// common initializer helpers
+#define TRACK_NUMBER(track,number) number,   // 1,2,3... ie default MIDI channels
+#define TRACK_ONE(track,number) 1,